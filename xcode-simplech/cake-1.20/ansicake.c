@@ -76,7 +76,7 @@ islegal(struct pos * position, int color, int from, int to, int jump)
 	struct move     movelist[MAXMOVES];
 	int             i, n, Lfrom, Lto;
 	char            c, Lstr[256];
-	extern struct pos p;	/* from cakepp.c  */
+	extern THREADLOCAL struct pos p;	/* from cakepp.c  */
 
 
 	/* get a movelist  */
@@ -86,7 +86,7 @@ islegal(struct pos * position, int color, int from, int to, int jump)
 		if (jump)
 			return 0;
 		else
-			n = makemovelist(movelist, color, 0, 0);
+			n = makemovelist(movelist, color, 0, NULL, 0);
 	}
 	/* for all moves: convert move to notation and compare  */
 	for (i = 0; i < n; i++) {
@@ -0,0 +1,31 @@
+/* bench.c: command line driver for the bench of testcake.c
+
+	usage: bench [depth [signature]]
+   	    bench multipv [depth]
+
+   searches the test positions to depth (default BENCHDEPTH of testcake.c) and
+   exits with 1 if the total number of nodes is not signature. with multipv it
+   checks the second lines of multi-pv searches instead, see testcake_multipv() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "structs.h"
+
+int testcake_bench(int depth, int32 signature);
+int testcake_multipv(int depth);
+
+int main(int argc, char *argv[])
+	{
+   int depth=0;
+   int32 signature=0;
+
+   if(argc>1 && strcmp(argv[1],"multipv")==0)
+   	{
+      if(argc>2) depth=atoi(argv[2]);
+      return testcake_multipv(depth)!=0;
+      }
+   if(argc>1) depth=atoi(argv[1]);
+   if(argc>2) signature=(int32)strtoul(argv[2],NULL,10);
+   return testcake_bench(depth,signature);
+   }
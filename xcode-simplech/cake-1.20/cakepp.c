@@ -77,6 +77,15 @@
 #include <conio.h>
 #include <windows.h>
 #endif/*SYSTEM*/
+#ifndef SYS_WINDOWS
+#include <pthread.h>
+#include <sched.h>
+#endif
+#if defined(TREELOG) && !defined(SYS_WINDOWS)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 /* structs.h defines the data structures for cake++ */
 #include "structs.h"
@@ -92,54 +101,259 @@
 void boardtobitboard(int b[8][8], struct pos *position);
 #endif
 
+/* globals */
+/* cake++ keeps everything which belongs to one game in a struct cakeengine, so that
+	one process can search as many games at the same time as it has threads.
+   the search itself works on THREADLOCAL copies of the position, material,
+   hash key, variation and history table, which cake_enginegetmove sets up from
+   the engine on entry. only the read-only tables below are shared by all engines */
+static int32  hashxors[2][4][32];
+static int lastone[256];
+
+#ifdef TABLE8
+static int bitsinbyte[256];
+#endif
+
+#ifdef TABLE16
+static int bitsinword[65536];
+#endif
+
+int maxNdb=0; /* the largest number of stones which is still in the database */
+/* the shared tables are built once, by the first thread which creates an engine */
 #ifdef SYS_WINDOWS
-#define TICKS CLOCKS_PER_SEC
+static INIT_ONCE cakeinitonce=INIT_ONCE_STATIC_INIT;
+#else
+static pthread_once_t cakeinitonce=PTHREAD_ONCE_INIT;
+#endif
+static struct cakeengine *cake_default; /* the engine of initcake/cake_getmove */
+unsigned int cake_nodes; /* nodes of all threads in the last cake_getmove */
+
+/* the log: a ring of records which searches of any thread write without a lock and
+	without waiting. a slot can be written when its sequence number is the position
+   of the writer, and read when it is the position of the reader plus one */
+static struct cakelogrecord logring[LOGSIZE];
+static volatile long logsequence[LOGSIZE];
+static volatile long loghead,logtail;   /* next record to write and to read */
+static volatile long logdropped;        /* records lost because the ring was full */
+#ifdef LOGWRITER
+static volatile long logwriting;        /* the writer thread runs... */
+static FILE *logfile;                   /* ...and writes to this file */
+static int logexit;                     /* logatexit() is registered */
+#ifdef SYS_WINDOWS
+static HANDLE loghandle;
+#else
+static pthread_t loghandle;
 #endif
-#ifdef SYS_MACOS
-#define TICKS CLOCKS_PER_SEC
 #endif
-#ifdef SYS_UNIX
-#define TICKS CLOCKS_PER_SEC
-#endif /*SYSTEM*/
 
-/* globals */
-static FILE *cake_fp;
-struct pos p;
-unsigned int cake_nodes;
-static int dblookups;
-int logging;
-int *play; /*is nonzero if the engine is to play immediately */
-static int bm,bk,wm,wk;
-static int realdepth, maxdepth;
+/* search state of the current thread */
+static THREADLOCAL struct cakeengine *Gengine; /* engine this thread is searching for */
+static THREADLOCAL FILE *cake_fp;
+THREADLOCAL struct pos p;
+static THREADLOCAL unsigned int Gnodes; /* nodes of this thread */
+static THREADLOCAL struct cakestats Gstats; /* statistics of the search of this thread */
+THREADLOCAL int logging;
+static THREADLOCAL volatile long *Gstop; /* is nonzero if the search has to stop */
+static THREADLOCAL int *Gplaynow;   /* the playnow flag of cake_getmove, polled with the clock */
+static THREADLOCAL int Gpoll;       /* this thread polls the clock: the main thread */
+static THREADLOCAL long Gstridemask; /* ...every Gstridemask+1 nodes */
+static THREADLOCAL volatile long Gnostop; /* Gstop during the first iteration, which always finishes */
+static THREADLOCAL int bm,bk,wm,wk;
+static THREADLOCAL int realdepth, maxdepth;
 #ifdef REPCHECK
-static struct pos Ghistory[MAXDEPTH+HISTORYOFFSET+10]; /*holds the current variation for repetition check*/
+struct repentry
+	{
+   int64 key;                    /* Gkey and Glock of a position */
+   int reversible;               /* number of king moves without capture which led to it */
+   };
+static THREADLOCAL struct repentry Ghistory[MAXDEPTH+HISTORYOFFSET+10]; /*holds the current variation for repetition check*/
+#define repkey() (((int64)Gkey<<32)|Glock)
 #endif
 
 /* create two hashtables: one where all positions with realdepth < DEEP are stored, and
-	where the bucket size is large, and another where everything is overwritten all the time */
+	where the bucket size is large, and another where everything is overwritten all the time.
+   the tables belong to the engine, these are the pointers of the current thread */
+static THREADLOCAL struct hashentry *deep, *shallow;
+static THREADLOCAL int32 Gkey,Glock;
+static THREADLOCAL int Ggeneration; /* hashtable entries are tagged with the search they come from */
 
-static struct hashentry *deep, *shallow;
-static int32  hashxors[2][4][32];
-static int32 Gkey,Glock;
-static int lastone[256];
+static THREADLOCAL char *out;
+static THREADLOCAL int Gtruncationdepth=TRUNCATIONDEPTH;
 
-#ifdef TABLE8
-static int bitsinbyte[256];
+/* what domove changes besides the board, saved for undomove. one entry per ply */
+struct undo
+	{
+   int32 key,lock;
+   int bm,bk,wm,wk;
+   };
+static THREADLOCAL struct undo Gundo[MAXDEPTH+10];
+static THREADLOCAL double start,t,maxtime; /* time variables */
+static THREADLOCAL long long Gstartns;  /* the start of the search in nanotime() */
+static THREADLOCAL long long Ghardtime; /* the search stops once it has used this many ns */
+#define NOTIME 0x7FFFFFFFFFFFFFFFLL
+static THREADLOCAL double Gbestshare; /* part of the root nodes which went to the best move */
+#ifdef PROBCUTLOG
+static FILE *probcut_fp;                  /* samples for the probcut tool */
+static THREADLOCAL int Gprobcutsample;    /* this thread is taking a sample */
+#endif
+#ifdef PONDER
+static THREADLOCAL int Gponder; /* this thread runs a ponder search */
+#endif
+/* multi-pv: the best Gmultipv root moves get exact values. firstnegamax
+	leaves them here, best first */
+static THREADLOCAL int Gmultipv;
+static THREADLOCAL int Gmultipvn;
+static THREADLOCAL struct move Gmultipvmoves[MAXMULTIPV];
+static THREADLOCAL int Gmultipvvalues[MAXMULTIPV];
+
+/* history table: the engine keeps it from move to move, halved every time */
+THREADLOCAL int32 history[32][32];
+THREADLOCAL int32 historytotal;   /* sum of its entries, movegen scales by it */
+#ifdef MOCOUNTER
+/* countermoves: the move which last refuted a move of the opponent, by its from and to square */
+static THREADLOCAL int32 Gcountermoves[32][32];
 #endif
+/* killer moves: the last two non-capture moves which produced a cutoff on each ply */
+static THREADLOCAL int32 Gkillers[MAXDEPTH+10][2];
 
-#ifdef TABLE16
-static int bitsinword[65536];
+#ifdef TREELOG
+/* the search tree recorder of an engine: a file mapped into memory, which the
+	main thread of its searches appends a record to for every node it leaves */
+struct treefile
+	{
+   struct treeheader *header;    /* the mapping: the header, then the records */
+#ifdef SYS_WINDOWS
+   HANDLE file,mapping;
+#else
+   int file;
+#endif
+   };
+#define TREEFILESIZE (sizeof(struct treeheader)+TREELOGSIZE*sizeof(struct treerecord))
+static THREADLOCAL struct treeheader *Gtree; /* recorder of this thread, NULL if it doesn't record */
+/* why the node on each ply returned and with which move, for its record */
+static THREADLOCAL int8 Gtreecutoff[MAXDEPTH+10],Gtreemove[MAXDEPTH+10];
+#define treecutoff(c,i) (Gtreecutoff[realdepth]=(c),Gtreemove[realdepth]=(i))
+static void treeclose(struct treefile *t);
+#else
+#define treecutoff(c,i)
 #endif
 
-int hashsearch,hashhit,hashstores;
-static char *out;
-int maxNdb=0; /* the largest number of stones which is still in the database */
-static int Gtruncationdepth=TRUNCATIONDEPTH;
-double start,t,maxtime; /* time variables */
-int searchmode;
+#ifdef SMP
+/* lazy smp: the helper threads run their own iterative deepening on the root
+	position. they never report a move, they only fill the shared hashtables */
+struct smpthread
+	{
+   int id;
+   unsigned int nodes;
+   struct cakestats stats;       /* counters of the helper, summed up by smpstop */
+   struct cakeengine *engine;
+#ifdef SYS_WINDOWS
+   HANDLE handle;
+#else
+   pthread_t handle;
+#endif
+   };
+
+/* young brothers wait: once the first move of a node has been searched, the
+	node becomes a split point and idle threads steal its remaining moves */
+struct splitpoint
+	{
+   int active;
+   struct splitpoint *parent;    /* split point the owner was working for */
+   struct pos p;                 /* the complete search state at the node */
+   int bm,bk,wm,wk;
+   int32 key,lock;
+   int realdepth;
+#ifdef REPCHECK
+   struct repentry history[MAXDEPTH+HISTORYOFFSET+10];
+#endif
+   int color,d,truncationdepth,capture;
+   int alpha,beta;
+   struct move movelist[MAXMOVES];
+   int n,next;                   /* number of moves and next move to hand out */
+   struct move best;
+   volatile int workers;         /* threads searching a move of this node */
+   volatile int stop;            /* set on a beta cutoff */
+   };
 
-/* history table */
-int32 history[32][32];
+static THREADLOCAL struct splitpoint *Gsplit; /* split point this thread works for */
+#ifdef SYS_WINDOWS
+#define locksplit() EnterCriticalSection(&Gengine->splitlock)
+#define unlocksplit() LeaveCriticalSection(&Gengine->splitlock)
+#define yieldthread() Sleep(0)
+#else
+#define locksplit() pthread_mutex_lock(&Gengine->splitlock)
+#define unlocksplit() pthread_mutex_unlock(&Gengine->splitlock)
+#define yieldthread() sched_yield()
+#endif
+#endif
+
+struct cakeengine
+	{
+   struct hashentry *deep, *shallow;
+   int generation;               /* counts the searches, modulo MAXGENERATION */
+#ifdef REPCHECK
+   struct repentry gamehistory[HISTORYOFFSET]; /* the last positions of the game */
+   struct pos gamelast;          /* the position after the last move of cake++ */
+#endif
+   unsigned int nodes;           /* nodes of all threads in the last search */
+   volatile long stop;           /* the stop token: set by cake_stop or the clock... */
+   volatile long long stoprequest; /* ...at this nanotime() */
+   int nodestride;               /* the main thread polls the clock every nodestride nodes */
+   struct cakestats stats;       /* statistics of the last search */
+   char statsfile[256];          /* json lines go here if it is set */
+   int32 history[32][32];        /* move ordering which is kept between searches */
+   int32 historytotal;
+   int32 countermoves[32][32];
+   int multipv;                  /* number of root moves with exact values */
+   int usebook;                  /* play moves from the opening book */
+#ifdef TREELOG
+   struct treefile tree;         /* the nodes of the searches go here if it is mapped */
+#endif
+   void (*info)(struct cakeinfo *info, void *data); /* progress of the search goes here... */
+   void *infodata;               /* ...with this */
+   int nlines;                   /* result of the last multi-pv search */
+   struct cakeline lines[MAXMULTIPV];
+#ifdef SMP
+   int smpthreads;               /* number of threads including the main thread */
+   int smpstarted;               /* ...of which are running: smphelpers[1..smpstarted-1] */
+   int smpmode;
+   volatile long smpabort;       /* tells the helpers to stop */
+   volatile int smpidle;         /* number of ybwc helpers looking for work */
+   struct smpthread smphelpers[MAXTHREADS];
+   struct pos smproot;           /* root position and side to move for the helpers */
+   int smpcolor;
+   int smptruncationdepth;
+#ifdef REPCHECK
+   struct repentry smphistory[MAXDEPTH+HISTORYOFFSET+10];
+#endif
+   struct splitpoint splitpoints[SPLITMAX];
+#ifdef SYS_WINDOWS
+   CRITICAL_SECTION splitlock;
+#else
+   pthread_mutex_t splitlock;
+#endif
+#endif
+#ifdef PONDER
+   int ponderactive;             /* there is a ponder thread to finish */
+   volatile long pondering;      /* ...and it is still waiting for the hit */
+   volatile long long ponderhittime; /* nanotime() of the ponder hit */
+   struct pos ponderpos;         /* position after the expected reply */
+   int pondercolor,ponderhow,ponderdepth,ponderlog,pondervalue;
+   double pondermaxtime;
+   int32 pondermaxnodes;
+   char ponderstr[255];
+#ifdef REPCHECK
+   struct repentry pondergamehistory[HISTORYOFFSET]; /* to undo the ponder search on a miss */
+   struct pos pondergamelast;
+#endif
+#ifdef SYS_WINDOWS
+   HANDLE ponderhandle;
+#else
+   pthread_t ponderhandle;
+#endif
+#endif
+   };
 
 /*----------------------------------interface---------------------------------*/
 /* consists of initcake() exitcake() and getmove() */
@@ -160,12 +374,11 @@ int32 myrand(void)
 	return result;
 	}
 	
-int initcake(int log)
+static void cakeglobalinitonce(void)
 	{
+   /* initialize the tables which all engines share, see cakeglobalinit() */
    int i,j;
-   logging=log;
-	deep=malloc(HASHSIZEDEEP*sizeof(struct hashentry));
-   shallow=malloc(HASHSIZESHALLOW*sizeof(struct hashentry));
+
    /* initialize xors */
    srand(1);
    for(i=0;i<4;i++)
@@ -179,72 +392,1276 @@ int initcake(int log)
    #ifdef SYS_WINDOWS
    for(i=0;i<4;i++)
    	{
-      for(j=0;j<32;j++)
-   		{
-         hashxors[0][i][j] = myrand();
-         hashxors[1][i][j] = myrand();
-         }
+      for(j=0;j<32;j++)
+   		{
+         hashxors[0][i][j] = myrand();
+         hashxors[1][i][j] = myrand();
+         }
+      }
+   #endif
+   /* initialize array for "lastone" */
+   for(i=0;i<256;i++)
+   	{
+      if(i&BIT0) {lastone[i]=0;continue;}
+      if(i&BIT1) {lastone[i]=1;continue;}
+      if(i&BIT2) {lastone[i]=2;continue;}
+      if(i&BIT3) {lastone[i]=3;continue;}
+      if(i&BIT4) {lastone[i]=4;continue;}
+      if(i&BIT5) {lastone[i]=5;continue;}
+      if(i&BIT6) {lastone[i]=6;continue;}
+      if(i&BIT7) {lastone[i]=7;continue;}
+      }
+   /* initialize bitsinbyte */
+#ifdef TABLE8
+   for(i=0;i<256;i++)
+   	bitsinbyte[i]=recbitcount((int32)i);
+#endif
+#ifdef TABLE16
+	for(i=0;i<65536;i++)
+   	bitsinword[i]=recbitcount((int32)i);
+#endif
+   for(i=0;i<LOGSIZE;i++)
+   	logsequence[i]=i;
+#ifdef USEDB
+
+//    maxNdb=DBInit();
+        maxNdb = 4;
+        initbool();
+        initlookup();
+#endif
+   
+	/* load book */
+	i = initbook();
+	printf("\nloaded %i book positions",i);
+   }
+
+#ifdef SYS_WINDOWS
+static BOOL CALLBACK cakeglobalinitwin(PINIT_ONCE once, PVOID param, PVOID *context)
+	{
+   (void)once; (void)param; (void)context;
+   cakeglobalinitonce();
+   return TRUE;
+   }
+#endif
+
+static void cakeglobalinit(void)
+	{
+   /* initialize the shared tables before the first engine is created. engines
+   	can be created on several threads at once: the others wait until the
+      first one has built all the tables */
+#ifdef SYS_WINDOWS
+   InitOnceExecuteOnce(&cakeinitonce,cakeglobalinitwin,NULL,NULL);
+#else
+   pthread_once(&cakeinitonce,cakeglobalinitonce);
+#endif
+   }
+
+struct cakeengine *cake_createengine(int log)
+	{
+   /* create an engine with its own hashtables and game history. returns NULL
+   	if there is not enough memory */
+   struct cakeengine *e;
+
+   cakeglobalinit();
+   e=calloc(1,sizeof(struct cakeengine));
+   if(e==NULL) return NULL;
+	e->deep=malloc(HASHSIZEDEEP*sizeof(struct hashentry));
+   e->shallow=malloc(HASHSIZESHALLOW*sizeof(struct hashentry));
+   if(e->deep==NULL || e->shallow==NULL)
+   	{
+      cake_destroyengine(e);
+      return NULL;
+      }
+   memset(e->deep,0,HASHSIZEDEEP*sizeof(struct hashentry));
+   memset(e->shallow,0,HASHSIZESHALLOW*sizeof(struct hashentry));
+   e->multipv=1;
+   e->usebook=1;
+   e->nodestride=NODESTRIDE;
+#ifdef SMP
+   e->smpthreads=1;
+   e->smpstarted=1;
+   e->smpmode=SMPLAZY;
+#ifdef SYS_WINDOWS
+   InitializeCriticalSection(&e->splitlock);
+#else
+   pthread_mutex_init(&e->splitlock,NULL);
+#endif
+#endif
+#ifdef LOGWRITER
+	if(log & 1)
+   	cake_logtofile("cakelog.txt");
+#endif
+   return e;
+   }
+
+void cake_destroyengine(struct cakeengine *e)
+	{
+   if(e==NULL) return;
+#ifdef PONDER
+   cake_pondermiss(e);
+#endif
+#ifdef SMP
+#ifdef SYS_WINDOWS
+   DeleteCriticalSection(&e->splitlock);
+#else
+   pthread_mutex_destroy(&e->splitlock);
+#endif
+#endif
+#ifdef TREELOG
+   treeclose(&e->tree);
+#endif
+   /* deallocate memory for the hashtables */
+   free(e->deep);
+   free(e->shallow);
+   free(e);
+   }
+
+int initcake(int log)
+	{
+   logging=log;
+   cake_default=cake_createengine(log);
+   return cake_default!=NULL;
+   }
+
+int exitcake(void)
+
+	{
+   cake_destroyengine(cake_default);
+   cake_default=NULL;
+#ifdef LOGWRITER
+   cake_logtofile(NULL);
+#endif
+   return 1;
+   }
+
+long long nanotime(void)
+	{
+   /* returns a monotonic wall clock time in nanoseconds. clock() counts the cpu
+   	time of all threads of the process and can't be used once helper threads search */
+#ifdef SYS_WINDOWS
+   LARGE_INTEGER count,frequency;
+   QueryPerformanceCounter(&count);
+   QueryPerformanceFrequency(&frequency);
+   return (long long)((double)count.QuadPart*1e9/(double)frequency.QuadPart);
+#else
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC,&ts);
+   return (long long)ts.tv_sec*1000000000LL+ts.tv_nsec;
+#endif
+   }
+
+double walltime(void)
+	{
+   /* the same clock in seconds */
+   return (double)nanotime()/1e9;
+   }
+
+void cake_stop(struct cakeengine *e)
+	{
+   /* the stop token: the search of e stops at the next node and returns the result of
+   	its last complete iteration. safe to call from any thread. a search clears it
+      when it starts, so a stop which comes before that is lost */
+   if(e==NULL) e=cake_default;
+   if(e==NULL || atomicget(&e->stop)) return;
+   atomicset64(&e->stoprequest,nanotime());
+   atomicset(&e->stop,1);
+   }
+
+int cake_setnodestride(struct cakeengine *e, int nodes)
+	{
+   /* the main thread of a search looks at the clock and at the playnow flag of
+   	cake_getmove every nodes nodes. a short stride stops the search sooner
+      after its deadline, a long one costs less. returns the stride used */
+   int stride=1;
+
+   if(e==NULL) e=cake_default;
+   while(stride<nodes && stride<0x100000)
+   	stride<<=1;
+   e->nodestride=stride;
+   return stride;
+   }
+
+int cake_setmultipv(struct cakeengine *e, int k)
+	{
+   /* the k best moves are searched with an open window and get exact values,
+   	all others are only shown to be worse than them. cake_getlines returns
+      them after the search. e==NULL is the engine of initcake() */
+   if(e==NULL) e=cake_default;
+   if(k<1) k=1;
+   if(k>MAXMULTIPV) k=MAXMULTIPV;
+   e->multipv=k;
+   return e->multipv;
+   }
+
+int cake_setbook(struct cakeengine *e, int on)
+	{
+   /* with on==0 every position is searched, also those which are in the book.
+   	e==NULL is the engine of initcake() */
+   if(e==NULL) e=cake_default;
+   e->usebook=(on!=0);
+   return e->usebook;
+   }
+
+int cake_setinfo(struct cakeengine *e, void (*callback)(struct cakeinfo *info, void *data), void *data)
+	{
+   /* callback is called with data after every iteration, when an aspiration
+   	window fails and when another move becomes best. it runs on the thread
+      which searches, also for ponder searches, and must return quickly.
+      NULL turns it off. e==NULL is the engine of initcake() */
+   if(e==NULL) e=cake_default;
+   e->info=callback;
+   e->infodata=data;
+   return 1;
+   }
+
+int cake_getlines(struct cakeengine *e, struct cakeline lines[], int max)
+	{
+   /* copy up to max lines of the last search to lines. there are none
+   	with multipv 1, cake_enginegetmove has the result then */
+   int i;
+
+   if(e==NULL) e=cake_default;
+   for(i=0;i<e->nlines && i<max;i++)
+   	lines[i]=e->lines[i];
+   return i;
+   }
+
+static void getlines(int color)
+	{
+   /* turn the root moves of the last multi-pv iteration into lines */
+   struct cakeengine *e=Gengine;
+   int32 Lkey=Gkey,Llock=Glock;
+   char Lstr[256];
+   int i;
+
+   for(i=0;i<Gmultipvn;i++)
+   	{
+      movetonotation(p,Gmultipvmoves[i],e->lines[i].pv,color);
+      togglemove(Gmultipvmoves[i]);
+      e->lines[i].position=p;
+      e->lines[i].value=Gmultipvvalues[i];
+      getpv(Lstr,color^CC);
+      strcat(e->lines[i].pv," ");
+      strncat(e->lines[i].pv,Lstr,sizeof(e->lines[i].pv)-strlen(e->lines[i].pv)-1);
+      togglemove(Gmultipvmoves[i]);
+      }
+   e->nlines=Gmultipvn;
+   Gkey=Lkey;
+   Glock=Llock;
+   }
+
+static int kthvalue(int values[MAXMOVES], int n, int k)
+	{
+   /* the k-th largest of n values */
+   int i,j,larger;
+
+   for(i=0;i<n;i++)
+   	{
+      larger=0;
+      for(j=0;j<n;j++)
+      	{
+         if(values[j]>values[i] || (values[j]==values[i] && j<i))
+         	larger++;
+         }
+      if(larger==k-1) return values[i];
+      }
+   return -10000;
+   }
+
+int cake_getstats(struct cakeengine *e, struct cakestats *stats)
+	{
+   /* the statistics of the last search of the engine (NULL: of initcake()) */
+   if(e==NULL) e=cake_default;
+   *stats=e->stats;
+   return 1;
+   }
+
+int cake_setstatsfile(struct cakeengine *e, char *filename)
+	{
+   /* after every search, append its statistics as one json line to filename */
+   if(e==NULL) e=cake_default;
+   e->statsfile[0]=0;
+   if(filename!=NULL)
+   	{
+      strncpy(e->statsfile,filename,255);
+      e->statsfile[255]=0;
+      }
+   return 1;
+   }
+
+#ifdef TREELOG
+static void treeclose(struct treefile *t)
+	{
+   /* unmap the recorder and cut the file down to the records written */
+   long size;
+
+   if(t->header==NULL) return;
+   size=sizeof(struct treeheader)+t->header->n*sizeof(struct treerecord);
+#ifdef SYS_WINDOWS
+   UnmapViewOfFile(t->header);
+   CloseHandle(t->mapping);
+   SetFilePointer(t->file,size,NULL,FILE_BEGIN);
+   SetEndOfFile(t->file);
+   CloseHandle(t->file);
+#else
+   munmap(t->header,TREEFILESIZE);
+   ftruncate(t->file,size);
+   close(t->file);
+#endif
+   t->header=NULL;
+   }
+
+static void treerecord(int d, int color, int alpha, int beta, int value)
+	{
+   /* append the node which this thread leaves to its recorder. when the file
+   	is full the first records are kept */
+   struct treerecord *r;
+
+   if(Gtree->n>=Gtree->size) return;
+   r=(struct treerecord *)(Gtree+1)+Gtree->n;
+   r->key=Gkey;
+   r->lock=Glock;
+   r->alpha=(sint16)alpha;
+   r->beta=(sint16)beta;
+   r->value=(sint16)value;
+   r->depth=(sint16)d;
+   r->ply=(int8)realdepth;
+   r->color=(int8)color;
+   r->cutoff=Gtreecutoff[realdepth];
+   r->move=Gtreemove[realdepth];
+   Gtree->n++;
+   }
+#endif
+
+int cake_settreefile(struct cakeengine *e, char *filename)
+	{
+   /* record every node which the main thread of the engine's searches leaves in
+   	filename, for the tree tool. the file is mapped into memory, so the records
+      survive a program which is killed in a long search. NULL stops recording and
+      cuts the file to size. returns 0 without TREELOG or if the file can't be mapped */
+#ifdef TREELOG
+   struct treefile *t;
+
+   if(e==NULL) e=cake_default;
+   t=&e->tree;
+   treeclose(t);
+   if(filename==NULL) return 1;
+#ifdef SYS_WINDOWS
+   t->file=CreateFileA(filename,GENERIC_READ|GENERIC_WRITE,FILE_SHARE_READ,NULL,CREATE_ALWAYS,FILE_ATTRIBUTE_NORMAL,NULL);
+   if(t->file==INVALID_HANDLE_VALUE) return 0;
+   t->mapping=CreateFileMappingA(t->file,NULL,PAGE_READWRITE,0,(DWORD)TREEFILESIZE,NULL);
+   if(t->mapping==NULL) {CloseHandle(t->file);return 0;}
+   t->header=MapViewOfFile(t->mapping,FILE_MAP_WRITE,0,0,TREEFILESIZE);
+   if(t->header==NULL) {CloseHandle(t->mapping);CloseHandle(t->file);return 0;}
+#else
+   t->file=open(filename,O_RDWR|O_CREAT|O_TRUNC,0644);
+   if(t->file<0) return 0;
+   if(ftruncate(t->file,TREEFILESIZE)!=0) {close(t->file);return 0;}
+   t->header=mmap(NULL,TREEFILESIZE,PROT_READ|PROT_WRITE,MAP_SHARED,t->file,0);
+   if(t->header==MAP_FAILED) {t->header=NULL;close(t->file);return 0;}
+#endif
+   t->header->magic=TREEMAGIC;
+   t->header->recordsize=sizeof(struct treerecord);
+   t->header->size=TREELOGSIZE;
+   t->header->n=0;
+   return 1;
+#else
+   (void)e;
+   (void)filename;
+   return 0;
+#endif
+   }
+
+static void addstats(struct cakestats *s, struct cakestats *h)
+	{
+   /* add the counters of a helper thread to those of the search */
+   s->deepprobes+=h->deepprobes;
+   s->deephits+=h->deephits;
+   s->deepcutoffs+=h->deepcutoffs;
+   s->shallowprobes+=h->shallowprobes;
+   s->shallowhits+=h->shallowhits;
+   s->shallowcutoffs+=h->shallowcutoffs;
+   s->etccutoffs+=h->etccutoffs;
+   s->failhighs+=h->failhighs;
+   s->failhighsfirst+=h->failhighsfirst;
+   s->dbprobes+=h->dbprobes;
+   s->dbhits+=h->dbhits;
+   s->extensions+=h->extensions;
+   s->truncations+=h->truncations;
+   s->probcuts+=h->probcuts;
+   if(h->seldepth>s->seldepth) s->seldepth=h->seldepth;
+   }
+
+static void writestats(struct cakeengine *e)
+	{
+   /* append the statistics of the last search to the stats file as one line
+   	of json. the line is written at once, so that engines can share a file */
+   struct cakestats *s=&e->stats;
+   char line[2048];
+   FILE *fp;
+   int i,len;
+
+   if(e->statsfile[0]==0) return;
+   len=sprintf(line,"{\"depth\":%i,\"seldepth\":%i,\"value\":%i,\"nodes\":%u,\"time\":%.3f,\"nps\":%.0f,\"iterationnodes\":[",
+   	s->depth,s->seldepth,s->value,s->nodes,s->time,s->nps);
+   for(i=0;i<s->iterations;i++)
+   	len+=sprintf(line+len,"%s%u",i?",":"",s->iternodes[i]);
+   len+=sprintf(line+len,"],\"deep\":{\"probes\":%u,\"hits\":%u,\"cutoffs\":%u},\"shallow\":{\"probes\":%u,\"hits\":%u,\"cutoffs\":%u}",
+   	s->deepprobes,s->deephits,s->deepcutoffs,s->shallowprobes,s->shallowhits,s->shallowcutoffs);
+   len+=sprintf(line+len,",\"etccutoffs\":%u,\"failhighs\":%u,\"failhighsfirst\":%u,\"fhf\":%.3f",
+   	s->etccutoffs,s->failhighs,s->failhighsfirst,s->failhighs ? (double)s->failhighsfirst/s->failhighs : 0.0);
+   len+=sprintf(line+len,",\"db\":{\"probes\":%u,\"hits\":%u},\"extensions\":%u,\"truncations\":%u,\"probcuts\":%u",
+   	s->dbprobes,s->dbhits,s->extensions,s->truncations,s->probcuts);
+   len+=sprintf(line+len,",\"stopped\":%i,\"stoplatency\":%.6f}\n",s->stopped,s->stoplatency);
+   fp=fopen(e->statsfile,"a");
+   if(fp==NULL) return;
+   fputs(line,fp);
+   fclose(fp);
+   }
+
+static long long searchstartns(void)
+	{
+   /* when the clock of this search started: a ponder search runs on the opponent's
+   	time and its clock only starts with the ponder hit. NOTIME before that */
+#ifdef PONDER
+   if(Gponder)
+   	{
+      if(atomicget(&Gengine->pondering)) return NOTIME;
+      return atomicget64(&Gengine->ponderhittime);
+      }
+#endif
+   return Gstartns;
+   }
+
+static double searchtime(void)
+	{
+   /* the time this search has used for time control */
+   long long s=searchstartns();
+
+   if(s==NOTIME) return 0;
+   return (double)(nanotime()-s)/1e9;
+   }
+
+static void pollstop(void)
+	{
+   /* every Gstridemask+1 nodes the main thread turns a set playnow flag or a
+   	passed deadline into a stop. the request time of a deadline is the deadline
+      itself, so that the stop latency includes the polling delay */
+   long long s;
+
+   if(Gplaynow!=NULL && *(volatile int *)Gplaynow)
+   	{
+      cake_stop(Gengine);
+      return;
+      }
+   if(Ghardtime==NOTIME) return;
+   s=searchstartns();
+   if(s==NOTIME) return;
+   if(nanotime()>=s+Ghardtime && !atomicget(&Gengine->stop))
+   	{
+      atomicset64(&Gengine->stoprequest,s+Ghardtime);
+      atomicset(&Gengine->stop,1);
+      }
+   }
+
+static void agehistory(void)
+	{
+   /* halve the history table: old cutoffs count less than new ones */
+   int i,j;
+
+   for(i=0;i<32;i++)
+   	for(j=0;j<32;j++)
+      	history[i][j]>>=1;
+   historytotal>>=1;
+   }
+
+int cake_setthreads(struct cakeengine *e, int n)
+	{
+   /* set the number of threads the engine searches with, the main thread
+   	included. e==NULL is the engine of initcake(). returns the number of
+      threads which will be used */
+#ifdef SMP
+   if(e==NULL) e=cake_default;
+   if(n<1) n=1;
+   if(n>MAXTHREADS) n=MAXTHREADS;
+   e->smpthreads=n;
+   return e->smpthreads;
+#else
+   return 1;
+#endif
+   }
+
+int cake_setsmpmode(struct cakeengine *e, int mode)
+	{
+   /* choose how the threads work together: SMPLAZY (shared hashtables only)
+   	or SMPYBWC (split points). e==NULL is the engine of initcake().
+      returns the mode which will be used */
+#ifdef SMP
+   if(e==NULL) e=cake_default;
+   if(mode==SMPLAZY || mode==SMPYBWC)
+   	e->smpmode=mode;
+   return e->smpmode;
+#else
+   return SMPLAZY;
+#endif
+   }
+
+unsigned int searchnodes(void)
+	{
+   /* the number of nodes searched so far by all threads */
+   unsigned int n=Gnodes;
+#ifdef SMP
+   int i;
+   for(i=1;i<Gengine->smpstarted;i++)
+   	n+=Gengine->smphelpers[i].nodes;
+#endif
+   return n;
+   }
+
+static void infostring(char *str, struct pos position, struct cakeinfo *info, unsigned int dbprobes)
+	{
+   /* the line of text for an iteration which cake_getmove returns and logs */
+   char Lstr[256];
+   double t=info->time;
+
+   movetonotation(position,info->pv[0],Lstr,info->color);
+   if(info->bound==LOWER)
+   	sprintf(str,"best: %s depth %i/%i nodes %u value>%i time %3.2fs",Lstr,info->depth,info->seldepth,info->nodes,info->value,t);
+   else if(info->bound==UPPER)
+   	sprintf(str,"best: %s depth %i/%i nodes %u value<%i time %3.2fs",Lstr,info->depth,info->seldepth,info->nodes,info->value,t);
+   else if(t>0)
+   	sprintf(str,"best: %s depth %i/%i nodes %u value %i time %3.2fs %4.0fkN/s db %u",Lstr,info->depth,info->seldepth,info->nodes,info->value,t,info->nodes/1000/t,dbprobes);
+   else
+   	sprintf(str,"best: %s depth %i/%i nodes %u value %i time %3.2fs ?kN/s db %u",Lstr,info->depth,info->seldepth,info->nodes,info->value,t,dbprobes);
+   }
+
+static void writelog(int type, struct pos position, int color, int value, struct cakeinfo *info)
+	{
+   /* put a record into the log ring. if the ring is full the record is dropped:
+   	the search never waits for the log */
+   struct cakelogrecord *r;
+   long pos,seq;
+
+   for(;;)
+   	{
+      pos=atomicget(&loghead);
+      seq=atomicget(&logsequence[pos&(LOGSIZE-1)]);
+      if(seq==pos)
+      	{
+         if(atomiccas(&loghead,pos,pos+1)) break;
+         }
+      else if(seq<pos)
+      	{
+         atomicadd(&logdropped,1);
+         return;
+         }
+      }
+   r=&logring[pos&(LOGSIZE-1)];
+   r->type=type;
+   r->ns=nanotime();
+   r->position=position;
+   r->color=color;
+   r->value=value;
+   r->dbprobes=Gstats.dbprobes;
+   if(info!=NULL)
+   	r->info=*info;
+   else
+   	r->info.npv=0;
+   atomicset(&logsequence[pos&(LOGSIZE-1)],pos+1);
+   }
+
+int cake_readlog(struct cakelogrecord records[], int max)
+	{
+   /* take up to max records out of the log ring, the oldest first. returns their
+   	number. the writer thread of cake_logtofile() reads the same ring */
+   long pos,seq;
+   int n=0;
+
+   while(n<max)
+   	{
+      pos=atomicget(&logtail);
+      seq=atomicget(&logsequence[pos&(LOGSIZE-1)]);
+      if(seq==pos+1)
+      	{
+         if(atomiccas(&logtail,pos,pos+1))
+         	{
+            records[n++]=logring[pos&(LOGSIZE-1)];
+            atomicset(&logsequence[pos&(LOGSIZE-1)],pos+LOGSIZE);
+            }
+         }
+      else if(seq<pos+1)
+      	break;
+      }
+   return n;
+   }
+
+long cake_logdropped(void)
+	{
+   /* the number of records which did not fit into the log ring */
+   return atomicget(&logdropped);
+   }
+
+#ifdef LOGWRITER
+static void printlogrecord(struct cakelogrecord *r)
+	{
+   /* write a record to cake_fp as text, as the log always looked */
+   char Lstr[256],line[256];
+   struct pos q;
+   struct move *m;
+   int i,color;
+
+   switch(r->type)
+   	{
+      case LOGSEARCH:
+      	printboardtofile(r->position);
+         fprintf(cake_fp,"\nposition hex:bm%x bk%x wm%x wk%x",r->position.bm,r->position.bk,r->position.wm,r->position.wk);
+         break;
+      case LOGBOOK:
+      	fprintf(cake_fp,"\nbook move");
+      	printboardtofile(r->position);
+         break;
+      case LOGINFO:
+      	infostring(line,r->position,&r->info,r->dbprobes);
+         fprintf(cake_fp,"\n%s",line);
+         break;
+      case LOGRESULT:
+      	q=r->position;
+         color=r->color;
+         strcpy(line,"");
+         for(i=0;i<r->info.npv;i++)
+         	{
+            m=&r->info.pv[i];
+            movetonotation(q,*m,Lstr,color);
+            strcat(line,Lstr);
+            strcat(line," ");
+            q.bm^=m->bm;q.bk^=m->bk;q.wm^=m->wm;q.wk^=m->wk;
+            color=color^CC;
+            }
+         fprintf(cake_fp,"\nPV: %s\n",line);
+         break;
+      }
+   }
+
+static void drainlog(void)
+	{
+   /* write all records there are to the log file */
+   struct cakelogrecord records[16];
+   int i,n;
+
+   while((n=cake_readlog(records,16))>0)
+   	for(i=0;i<n;i++)
+      	printlogrecord(&records[i]);
+   fflush(cake_fp);
+   }
+
+#ifdef SYS_WINDOWS
+static DWORD WINAPI logthreadproc(LPVOID arg)
+#else
+static void *logthreadproc(void *arg)
+#endif
+	{
+#ifndef SYS_WINDOWS
+   struct timespec wait;
+#endif
+
+   (void)arg;
+#ifndef SYS_WINDOWS
+   wait.tv_sec=0;
+   wait.tv_nsec=LOGWAIT*1000000L;
+#endif
+   cake_fp=logfile;
+   while(atomicget(&logwriting))
+   	{
+      drainlog();
+#ifdef SYS_WINDOWS
+      Sleep(LOGWAIT);
+#else
+      nanosleep(&wait,NULL);
+#endif
+      }
+   drainlog();
+#ifdef SYS_WINDOWS
+   return 0;
+#else
+   return NULL;
+#endif
+   }
+
+static void logatexit(void)
+	{
+   /* what is still in the ring goes to the file when the program ends */
+   cake_logtofile(NULL);
+   }
+
+int cake_logtofile(char *filename)
+	{
+   /* start a thread which writes the log ring to filename as text, every LOGWAIT ms.
+   	NULL stops it after it has written what is left. returns 0 if the file can't
+      be opened. cake_createengine() with logging&1 does this for cakelog.txt */
+   if(filename==NULL)
+   	{
+      if(!atomicget(&logwriting)) return 1;
+      atomicset(&logwriting,0);
+#ifdef SYS_WINDOWS
+      WaitForSingleObject(loghandle,INFINITE);
+      CloseHandle(loghandle);
+#else
+      pthread_join(loghandle,NULL);
+#endif
+      fclose(logfile);
+      logfile=NULL;
+      return 1;
+      }
+   if(atomicget(&logwriting)) return 1;
+   logfile=fopen(filename,"w");
+   if(logfile==NULL) return 0;
+   if(!logexit) atexit(logatexit);
+   logexit=1;
+   atomicset(&logwriting,1);
+#ifdef SYS_WINDOWS
+   loghandle=CreateThread(NULL,0,logthreadproc,NULL,0,NULL);
+   if(loghandle==NULL)
+#else
+   if(pthread_create(&loghandle,NULL,logthreadproc,NULL)!=0)
+#endif
+   	{
+      /* no thread: nothing to join later */
+      atomicset(&logwriting,0);
+      fclose(logfile);
+      logfile=NULL;
+      return 0;
+      }
+   return 1;
+   }
+#endif
+
+static void report(int d, int value, int bound, struct move best, int color)
+	{
+   /* tell the caller how the search goes: the info callback gets the numbers and
+   	the pv, the log ring and stdout get them with logging&1 and logging&2.
+      without any of them nothing is done */
+   struct cakeengine *e=Gengine;
+   struct cakeinfo info;
+   char Lstr[256];
+
+   if(e->info==NULL && !(logging&3)) return;
+   info.depth=d;
+   info.seldepth=maxdepth;
+   info.value=value;
+   info.bound=bound;
+   info.nodes=searchnodes();
+   info.time=walltime()-start;
+   info.nps=info.time>0 ? info.nodes/info.time : 0;
+   info.color=color;
+   info.pv[0]=best;
+   info.npv=1;
+   if(e->info!=NULL)
+   	{
+      togglemove(best);
+      info.npv+=getpvmoves(info.pv+1,MAXPV-1,color^CC);
+      togglemove(best);
+      e->info(&info,e->infodata);
+      }
+   if(logging&1)
+   	writelog(LOGINFO,p,color,value,&info);
+   if(logging&2)
+   	{
+      infostring(Lstr,p,&info,Gstats.dbprobes);
+      printf("\n%s",Lstr);
+      fflush(stdout);
+      }
+   }
+
+static INLINE void domove(struct move m, int color)
+	{
+   /* make a move: save hash key and material of this ply on the undo stack,
+   	then update board, material, hash key and the variation. the captured
+      stones are exactly the opponent's bits of the move */
+   struct undo *u=&Gundo[realdepth];
+
+   u->key=Gkey;
+   u->lock=Glock;
+   u->bm=bm;u->bk=bk;u->wm=wm;u->wk=wk;
+   togglemove(m);
+   if(color==BLACK)
+   	{
+      if(m.wm) wm-=bitcount(m.wm);
+      if(m.wk) wk-=bitcount(m.wk);
+      bk+=isprom(m.info);
+      bm-=isprom(m.info);
+      }
+   else
+   	{
+      if(m.bm) bm-=bitcount(m.bm);
+      if(m.bk) bk-=bitcount(m.bk);
+      wk+=isprom(m.info);
+      wm-=isprom(m.info);
+      }
+   updatehashkey(m);
+   realdepth++;
+#ifdef REPCHECK
+   Ghistory[realdepth+HISTORYOFFSET].key=repkey();
+   /* only a king move which captures nothing can be repeated */
+   if((m.bm|m.wm|((color==BLACK) ? m.wk : m.bk))==0)
+   	Ghistory[realdepth+HISTORYOFFSET].reversible=Ghistory[realdepth+HISTORYOFFSET-1].reversible+1;
+   else
+   	Ghistory[realdepth+HISTORYOFFSET].reversible=0;
+#endif
+   }
+
+static INLINE void undomove(struct move m)
+	{
+   /* take back the move domove made last */
+   struct undo *u;
+
+   realdepth--;
+   u=&Gundo[realdepth];
+   togglemove(m);
+   Gkey=u->key;
+   Glock=u->lock;
+   bm=u->bm;bk=u->bk;wm=u->wm;wk=u->wk;
+   }
+
+#ifdef REPCHECK
+static INLINE int repetition(void)
+	{
+   /* is the position the same as one earlier in the variation or the game?
+   	only the keys since the last man move or capture can match, and those of
+      the same side to move. two plies back the side to move can't have undone
+      its move yet */
+   int i,last;
+   int64 key;
+
+   i=realdepth+HISTORYOFFSET;
+   key=Ghistory[i].key;
+   last=i-Ghistory[i].reversible;
+   if(last<0) last=0;
+   for(i-=4;i>=last;i-=2)
+   	if(Ghistory[i].key==key) return 1;
+   return 0;
+   }
+
+static int reversible(struct pos *from, struct pos *to)
+	{
+   /* can the move from one position to the other be repeated? not if a man moved or
+   	something was captured */
+   return from->bm==to->bm && from->wm==to->wm &&
+   	bitcount(from->bk)==bitcount(to->bk) && bitcount(from->wk)==bitcount(to->wk);
+   }
+#endif
+
+#ifdef MATEPRUNING
+static INLINE int matedistance(int *alpha, int *beta)
+	{
+   /* at this ply the side to move can't lose faster than now or win faster
+   	than on the next ply: no window beyond that. returns 1 if nothing is left */
+   if(*alpha<-MATE+realdepth) *alpha=-MATE+realdepth;
+   if(*beta>MATE-realdepth-1) *beta=MATE-realdepth-1;
+   return *alpha>=*beta;
+   }
+#endif
+
+static INLINE int valuetohash(int value)
+	{
+   /* mate values in the hashtable count the plies from the stored position,
+   	not from the root, so that they are right wherever it is found again */
+   if(value>MATEVALUE) return value+realdepth;
+   if(value<-MATEVALUE) return value-realdepth;
+   return value;
+   }
+
+static INLINE int valuefromhash(int value)
+	{
+   if(value>MATEVALUE) return value-realdepth;
+   if(value<-MATEVALUE) return value+realdepth;
+   return value;
+   }
+
+#ifdef LMR
+static int lmrreduction(struct move m, int i, int d, int capture, int truncationdepth)
+	{
+   /* late move reductions: a quiet move far down the movelist which the move
+   	ordering did not like is first searched with less depth. nodes which are
+      already truncated are not reduced any further */
+   if(capture || truncationdepth || i<LMRMOVES || d<LMRDEPTH) return 0;
+   if(isprom(m.info)) return 0;
+   if(moveval(m.info)>=LMRVALUE) return 0;
+   return LMRREDUCTION;
+   }
+#endif
+
+#ifdef SMP
+static int splitaborted(void)
+	{
+   /* a cutoff at the split point this thread works for or at any split point
+   	above it makes the current work useless */
+   struct splitpoint *sp;
+
+   for(sp=Gsplit;sp!=NULL;sp=sp->parent)
+   	if(sp->stop) return 1;
+   return 0;
+   }
+
+static void splitwork(struct splitpoint *sp)
+	{
+   /* take moves from the split point and search them until none are left.
+   	the caller's search state must be the one stored in sp */
+   struct splitpoint *oldsplit=Gsplit;
+   struct move m;
+   int i,value,alpha;
+
+   Gsplit=sp;
+   for(;;)
+   	{
+      locksplit();
+      if(sp->stop || sp->next>=sp->n)
+      	{
+         unlocksplit();
+         break;
+         }
+      i=sp->next++;
+      alpha=sp->alpha;
+      unlocksplit();
+
+      m=sp->movelist[i];
+      domove(m,sp->color);
+
+      /********************recursion********************/
+#ifdef PVS
+      /* the first move of a split point is always searched already */
+      value=alpha+1;
+#ifdef LMR
+      if(lmrreduction(m,i,sp->d,sp->capture,sp->truncationdepth))
+      	value=-negamax(sp->d-10-LMRREDUCTION,sp->color^CC,-alpha-1,-alpha,sp->truncationdepth);
+#endif
+      if(value>alpha)
+      	value=-negamax(sp->d-10,sp->color^CC,-alpha-1,-alpha,sp->truncationdepth);
+      if(value>alpha && value<sp->beta && !atomicget(Gstop) && !splitaborted())
+      	value=-negamax(sp->d-10,sp->color^CC,-sp->beta,-alpha,sp->truncationdepth);
+#else
+      value=-negamax(sp->d-10,sp->color^CC,-sp->beta,-alpha,sp->truncationdepth);
+#endif
+      /*************************************************/
+      undomove(m);
+
+      if(atomicget(Gstop) || splitaborted()) break;
+      locksplit();
+      if(value>sp->alpha)
+      	{
+         sp->alpha=value;
+         sp->best=m;
+         if(value>=sp->beta) sp->stop=1;
+         }
+      unlocksplit();
+      }
+   Gsplit=oldsplit;
+   }
+
+static void loadsplit(struct splitpoint *sp)
+	{
+   /* take over the search state stored in the split point */
+   p=sp->p;
+   bm=sp->bm;bk=sp->bk;wm=sp->wm;wk=sp->wk;
+   Gkey=sp->key;
+   Glock=sp->lock;
+   realdepth=sp->realdepth;
+#ifdef REPCHECK
+   memcpy(Ghistory,sp->history,(realdepth+HISTORYOFFSET+1)*sizeof(struct repentry));
+#endif
+   }
+
+static int splitbelow(struct splitpoint *sp, struct splitpoint *top)
+	{
+   /* is sp a split point which one of the moves of top led to? */
+   for(sp=sp->parent;sp!=NULL;sp=sp->parent)
+   	if(sp==top) return 1;
+   return 0;
+   }
+
+static int split(struct move movelist[MAXMOVES], int n, int color, int d, int *alpha, int beta,
+					  struct move *best, int capture, int truncationdepth)
+	{
+   /* turn the current node into a split point and search moves 1...n-1 together
+   	with the idle helpers. returns 0 if no split point was available */
+   struct splitpoint *sp=NULL,*child;
+   int i;
+
+   locksplit();
+   for(i=0;i<SPLITMAX;i++)
+   	{
+      if(!Gengine->splitpoints[i].active)
+      	{
+         sp=&Gengine->splitpoints[i];
+         break;
+         }
+      }
+   if(sp==NULL)
+   	{
+      unlocksplit();
+      return 0;
+      }
+   sp->parent=Gsplit;
+   sp->p=p;
+   sp->bm=bm;sp->bk=bk;sp->wm=wm;sp->wk=wk;
+   sp->key=Gkey;
+   sp->lock=Glock;
+   sp->realdepth=realdepth;
+#ifdef REPCHECK
+   memcpy(sp->history,Ghistory,(realdepth+HISTORYOFFSET+1)*sizeof(struct repentry));
+#endif
+   sp->color=color;
+   sp->d=d;
+   sp->truncationdepth=truncationdepth;
+   sp->capture=capture;
+   sp->alpha=*alpha;
+   sp->beta=beta;
+   for(i=0;i<n;i++)
+   	sp->movelist[i]=movelist[i];
+   sp->n=n;
+   sp->next=1;
+   sp->best=*best;
+   sp->workers=1;
+   sp->stop=0;
+   sp->active=1;
+   unlocksplit();
+
+   splitwork(sp);
+
+   /* splitwork also returns on a stop or a cutoff above us, with moves left:
+   	no helper may take them any more */
+   locksplit();
+   sp->next=sp->n;
+   unlocksplit();
+   /* wait for the helpers which are still searching one of our moves. meanwhile
+   	help them at the split points below ours, which they wait for too */
+   for(;;)
+   	{
+      if(atomicget(Gstop)) sp->stop=1;
+      child=NULL;
+      locksplit();
+      if(sp->workers==1)
+      	{
+         *alpha=sp->alpha;
+         *best=sp->best;
+         sp->active=0;
+         unlocksplit();
+         return 1;
+         }
+      for(i=0;i<SPLITMAX;i++)
+      	{
+         if(Gengine->splitpoints[i].active && !Gengine->splitpoints[i].stop && Gengine->splitpoints[i].next<Gengine->splitpoints[i].n
+         	&& splitbelow(&Gengine->splitpoints[i],sp))
+         	{
+            child=&Gengine->splitpoints[i];
+            child->workers++;
+            break;
+            }
+         }
+      unlocksplit();
+      if(child==NULL)
+      	{
+         yieldthread();
+         continue;
+         }
+      loadsplit(child);
+      splitwork(child);
+      locksplit();
+      child->workers--;
+      unlocksplit();
+      /* back to the position of our own node */
+      loadsplit(sp);
+      }
+   }
+
+static void ybwchelper(struct smpthread *thread)
+	{
+   /* a ybwc helper: wait for a split point with moves left, take over the
+   	search state stored in it and help searching its moves */
+   struct splitpoint *sp;
+   int i;
+
+   locksplit();
+   Gengine->smpidle++;
+   unlocksplit();
+   while(!atomicget(&Gengine->smpabort))
+   	{
+      sp=NULL;
+      locksplit();
+      for(i=0;i<SPLITMAX;i++)
+      	{
+         if(Gengine->splitpoints[i].active && !Gengine->splitpoints[i].stop && Gengine->splitpoints[i].next<Gengine->splitpoints[i].n)
+         	{
+            sp=&Gengine->splitpoints[i];
+            sp->workers++;
+            Gengine->smpidle--;
+            break;
+            }
+         }
+      unlocksplit();
+      if(sp==NULL)
+      	{
+         yieldthread();
+         continue;
+         }
+
+      loadsplit(sp);
+      splitwork(sp);
+      thread->nodes=Gnodes;
+
+      locksplit();
+      sp->workers--;
+      Gengine->smpidle++;
+      unlocksplit();
+      }
+   locksplit();
+   Gengine->smpidle--;
+   unlocksplit();
+   }
+
+static void smphelper(struct smpthread *thread)
+	{
+   /* a lazy smp helper: searches the root position with its own iterative
+   	deepening until the main thread is done. odd helpers search the even
+      depths so that the threads don't all work on the same iteration.
+      in ybwc mode the helper only works on split points */
+   struct move best;
+   int d;
+
+   Gengine=thread->engine;
+   deep=Gengine->deep;
+   shallow=Gengine->shallow;
+   Ggeneration=Gengine->generation;
+   logging=0;
+   p=Gengine->smproot;
+   countmaterial();
+   absolutehashkey();
+   memcpy(history,Gengine->history,sizeof(history));
+   historytotal=Gengine->historytotal;
+   agehistory();
+#ifdef MOCOUNTER
+   memcpy(Gcountermoves,Gengine->countermoves,sizeof(Gcountermoves));
+#endif
+   memset(Gkillers,0,sizeof(Gkillers));
+#ifdef REPCHECK
+   memcpy(Ghistory,Gengine->smphistory,sizeof(Ghistory));
+#endif
+   Gtruncationdepth=Gengine->smptruncationdepth;
+   realdepth=0;maxdepth=0;
+   Gnodes=0;
+   memset(&Gstats,0,sizeof(Gstats));
+   Gstop=&Gengine->smpabort;
+   Gplaynow=NULL;
+   Gpoll=0; /* only the main thread looks at the clock */
+#ifdef TREELOG
+   Gtree=NULL; /* ...and records the tree */
+#endif
+
+   if(Gengine->smpmode==SMPYBWC)
+   	{
+      ybwchelper(thread);
+      thread->nodes=Gnodes;
+      thread->stats=Gstats;
+      return;
       }
-   #endif
-   /* initialize array for "lastone" */
-   for(i=0;i<256;i++)
+   for(d=1+(thread->id&1);d<MAXDEPTH && !atomicget(&Gengine->smpabort);d+=2)
    	{
-      if(i&BIT0) {lastone[i]=0;continue;}
-      if(i&BIT1) {lastone[i]=1;continue;}
-      if(i&BIT2) {lastone[i]=2;continue;}
-      if(i&BIT3) {lastone[i]=3;continue;}
-      if(i&BIT4) {lastone[i]=4;continue;}
-      if(i&BIT5) {lastone[i]=5;continue;}
-      if(i&BIT6) {lastone[i]=6;continue;}
-      if(i&BIT7) {lastone[i]=7;continue;}
+      firstnegamax(10*d,Gengine->smpcolor,-10000,10000,&best);
+      thread->nodes=Gnodes;
       }
-   /* initialize bitsinbyte */
-#ifdef TABLE8
-   for(i=0;i<256;i++)
-   	bitsinbyte[i]=recbitcount((int32)i);
+   thread->nodes=Gnodes;
+   thread->stats=Gstats;
+   }
+
+#ifdef SYS_WINDOWS
+static DWORD WINAPI smpthreadproc(LPVOID arg)
+	{
+   smphelper((struct smpthread *)arg);
+   return 0;
+   }
+#else
+static void *smpthreadproc(void *arg)
+	{
+   smphelper((struct smpthread *)arg);
+   return NULL;
+   }
 #endif
-#ifdef TABLE16
-	for(i=0;i<65536;i++)
-   	bitsinword[i]=recbitcount((int32)i);
+
+static void smpstart(int color)
+	{
+   /* hand the root position to smpthreads-1 helper threads and start them.
+   	if the system can't create them all, the search goes on with those which
+      are running */
+   int i;
+#ifndef SYS_WINDOWS
+   pthread_attr_t attr;
 #endif
-#ifdef USEDB
 
-//    maxNdb=DBInit();
-        maxNdb = 4;
-        initbool();
-        initlookup();
+   Gengine->smpstarted=1;
+   if(Gengine->smpthreads<2) return;
+   atomicset(&Gengine->smpabort,0);
+   Gengine->smproot=p;
+   Gengine->smpcolor=color;
+   Gengine->smptruncationdepth=Gtruncationdepth;
+#ifdef REPCHECK
+   memcpy(Gengine->smphistory,Ghistory,sizeof(Gengine->smphistory));
 #endif
-   
-	/* load book */
-	i = initbook();
-	printf("\nloaded %i book positions",i);
-	
-	if(log & 1)
-      /* delete old logfile */
+#ifndef SYS_WINDOWS
+   pthread_attr_init(&attr);
+   pthread_attr_setstacksize(&attr,SMPSTACKSIZE);
+#endif
+   for(i=1;i<Gengine->smpthreads;i++)
    	{
-      cake_fp=fopen("cakelog.txt","w");
-      fclose(cake_fp);
+      Gengine->smphelpers[i].id=i;
+      Gengine->smphelpers[i].nodes=0;
+      Gengine->smphelpers[i].engine=Gengine;
+#ifdef SYS_WINDOWS
+      Gengine->smphelpers[i].handle=CreateThread(NULL,SMPSTACKSIZE,smpthreadproc,&Gengine->smphelpers[i],0,NULL);
+      if(Gengine->smphelpers[i].handle==NULL) break;
+#else
+      if(pthread_create(&Gengine->smphelpers[i].handle,&attr,smpthreadproc,&Gengine->smphelpers[i])!=0) break;
+#endif
+      Gengine->smpstarted++;
       }
-
-
-
-   return 1;
+#ifndef SYS_WINDOWS
+   pthread_attr_destroy(&attr);
+#endif
    }
 
-int exitcake(void)
-
+static void smpstop(void)
 	{
-   /*   fclose(cake_fp);*/
-/* deallocate memory for the hashtables */
-	free(deep);
-   free(shallow);
-   return 1;
+   /* stop the helper threads and wait until they are gone */
+   int i;
+
+   if(Gengine->smpthreads<2) return;
+   atomicset(&Gengine->smpabort,1);
+   for(i=1;i<Gengine->smpstarted;i++)
+   	{
+#ifdef SYS_WINDOWS
+      WaitForSingleObject(Gengine->smphelpers[i].handle,INFINITE);
+      CloseHandle(Gengine->smphelpers[i].handle);
+#else
+      pthread_join(Gengine->smphelpers[i].handle,NULL);
+#endif
+      addstats(&Gstats,&Gengine->smphelpers[i].stats);
+      }
    }
+#endif
 
 int cake_getmove(struct pos *position,int color, int how,double maximaltime, int depthtosearch, int32 maxnodes,
                  char str[255], int *playnow, int log, int reset)
 	{
-   /* cake_getmove is the entry point to cake++
+   /* the old single-game interface: search with the engine of initcake() */
+   int value;
+
+   value=cake_enginegetmove(cake_default,position,color,how,maximaltime,depthtosearch,maxnodes,str,playnow,log,reset);
+   cake_nodes=cake_default->nodes;
+   return value;
+   }
+
+int cake_enginegetmove(struct cakeengine *e, struct pos *position,int color, int how,double maximaltime,
+							  int depthtosearch, int32 maxnodes, char str[255], int *playnow, int log, int reset)
+	{
+   /* cake_enginegetmove is the entry point to cake++
    	give a pointer to a position and you get the new position in
       this structure after cake++ has calculated.
 
@@ -253,57 +1670,84 @@ int cake_getmove(struct pos *position,int color, int how,double maximaltime, int
       how is 0 for time-based search and 1 for depth-based search and 2 for node-based search
 
       maxtime and depthtosearch and maxnodes are used for these two search modes.
+      in time mode, maxtime is the budget in seconds of wall clock time: an
+      iteration is only started if it is expected to finish within maxtime,
+      and at TIMEHARD*maxtime the search is aborted.
 
       cake++ prints information in str
 
-      if playnow is set to a value != 0 cake++ aborts the search.
+      if playnow is set to a value != 0 cake++ aborts the search, like cake_stop()
+      does. it is looked at every nodestride nodes and may be NULL.
 
 		if (logging&1) cake++ will write information into "log.txt"
 
       if(logging&2) cake++ will also print the information to stdout.
 
       if reset!=0 cake++ will reset hashtables and repetition checklist
+
+      the search runs on the calling thread (and on its helpers with SMP),
+      different engines can search on different threads at the same time.
       */
 
 
 
 	int d;
 
-   int value,lastvalue=0,n,i,j;
+   int value,lastvalue=0,n,interrupted=0;
    struct move best,last, movelist[MAXMOVES];
-   struct pos dummy;
+   struct pos root;
+   struct cakeinfo info;
    char Lstr[256];
-   char tempstr[255];
    int32 bookmove;
+   unsigned int nodes=0,lastnodes=0;
+   int window=ASPIRATIONWINDOW;
+   double elapsed,iterstart,itertime,lastitertime=0,branch;
 
-   play=playnow;
+#ifdef PONDER
+   /* a new search means the ponder search was not needed */
+   if(!Gponder) cake_pondermiss(e);
+#endif
+   Gengine=e;
+   deep=e->deep;
+   shallow=e->shallow;
+   /* a ponder search was given a clear token by cake_ponder, any other search
+   	clears it here */
+#ifdef PONDER
+   if(!Gponder)
+#endif
+   	atomicset(&e->stop,0);
+   Gstop=&Gnostop;
+   Gplaynow=playnow;
+   Gpoll=1;
+   Gstridemask=e->nodestride-1;
+#ifdef TREELOG
+   Gtree=e->tree.header;
+#endif
    out=str;
    logging=log;
    maxtime=maximaltime;
-   searchmode=how;
+   Gmultipv=e->multipv;
+   e->nlines=0;
+   memset(&Gstats,0,sizeof(Gstats));
+   e->stats=Gstats;
+#ifdef PROBCUTLOG
+   if(probcut_fp==NULL) probcut_fp=fopen("probcut.txt","a");
+#endif
 
    p=(*position);
    if(logging & 1)
-   	{
-      cake_fp=fopen("cakelog.txt","a");
-      printboardtofile(p);
-      fprintf(cake_fp,"\nposition hex:bm%x bk%x wm%x wk%x",p.bm,p.bk,p.wm,p.wk);
-   	}
+      writelog(LOGSEARCH,p,color,0,NULL);
 
 	/* search position in book */
-	bookmove = booklookup(&p, color);
+	bookmove = e->usebook ? booklookup(&p, color) : 0;
 	if(bookmove != 0)
 		{
 		printf("\nbook move\n");
 		/* set the struct move 'best' to the book move */
 		bookmovetomove(bookmove, &best, &p, color);
-		if(logging & 1)
-			printboardtofile(p);
 		togglemove(best);
 		if(logging & 1)
-			printboardtofile(p);
-		if(logging & 1)
-			fclose(cake_fp);
+			writelog(LOGBOOK,p,color^CC,0,NULL);
 		*position = p;
 		return 0;
 		}
@@ -316,15 +1760,7 @@ int cake_getmove(struct pos *position,int color, int how,double maximaltime, int
    wm=bitcount(p.wm);
    wk=bitcount(p.wk);
 
-   /* reset history table */
-   for(i=0;i<32;i++)
-   	{
-      for(j=0;j<32;j++)
-      	{
-         history[i][j]=0;
-         history[i][j]=0;
-         }
-      }
+   memset(Gkillers,0,sizeof(Gkillers));
 
    /* set truncation depth setting:
    	in endgames do not truncate any more */
@@ -333,14 +1769,30 @@ int cake_getmove(struct pos *position,int color, int how,double maximaltime, int
    else 
 	   Gtruncationdepth=TRUNCATIONDEPTH;
 
-   /* clear the hashtable */
-   memset(deep,0,HASHSIZEDEEP*sizeof(struct hashentry));
-   /*if(reset!=0)*/
-   memset(shallow,0,HASHSIZESHALLOW*sizeof(struct hashentry));
+   /* the hashtables are kept from move to move, only a reset clears them.
+   	entries of earlier searches are still used, but are the first to
+      be overwritten */
+   if(reset!=0)
+   	{
+      memset(deep,0,HASHSIZEDEEP*sizeof(struct hashentry));
+      memset(shallow,0,HASHSIZESHALLOW*sizeof(struct hashentry));
+      memset(e->history,0,sizeof(e->history));
+      e->historytotal=0;
+      memset(e->countermoves,0,sizeof(e->countermoves));
+      }
+   /* the history of the last search counts half as much as that of this one */
+   memcpy(history,e->history,sizeof(history));
+   historytotal=e->historytotal;
+   agehistory();
+#ifdef MOCOUNTER
+   memcpy(Gcountermoves,e->countermoves,sizeof(Gcountermoves));
+#endif
+   e->generation=(e->generation+1)%MAXGENERATION;
+   Ggeneration=e->generation;
 
-   start=clock();
-   cake_nodes=0;
-   dblookups=0;
+   Gstartns=nanotime();
+   start=(double)Gstartns/1e9;
+   Gnodes=0;
    n=makecapturelist(movelist, color, 0);
 
 
@@ -348,164 +1800,436 @@ int cake_getmove(struct pos *position,int color, int how,double maximaltime, int
 
    /*reset=0;*/
 
+   absolutehashkey();
 #ifdef REPCHECK
-   /*initialize history list */
-	Ghistory[HISTORYOFFSET]=p;
-   dummy.bm=BIT0;
-   dummy.wm=BIT0;
-   dummy.bk=BIT0;
-   dummy.wk=BIT0;
-   if(reset==0)
-   	{
-      for(i=0;i<HISTORYOFFSET-2;i++)
-   		Ghistory[i]=Ghistory[i+2];
-      }
+   /*initialize history list: the game so far, then the root */
+   memcpy(Ghistory,e->gamehistory,sizeof(e->gamehistory));
+   Ghistory[HISTORYOFFSET].key=repkey();
+   if(reset==0 && reversible(&e->gamelast,&p))
+   	Ghistory[HISTORYOFFSET].reversible=Ghistory[HISTORYOFFSET-1].reversible+1;
    else
-   	{
-      for(i=0;i<HISTORYOFFSET;i++)
-      	Ghistory[i]=dummy;
-      }
+   	Ghistory[HISTORYOFFSET].reversible=0;
+#endif
+#ifdef SMP
+   /* start the helper threads on the same root position */
+   smpstart(color);
 #endif
-
-   hashsearch=0;
-   hashhit=0;
-   hashstores=0;
-   absolutehashkey();
   		
+   /* multi-pv values have to be exact: no aspiration window */
+   if(Gmultipv>1) window=20000;
+   /* the first iteration always finishes, it provides the move for a stop */
+   Ghardtime=NOTIME;
    for(d=1;d<MAXDEPTH;d+=2)
   		{
+         if(d>1) Gstop=&e->stop;
+         iterstart=searchtime();
       	/*do a search with aspiration window*/
-      	value=firstnegamax(10*d,color,lastvalue-ASPIRATIONWINDOW,lastvalue+ASPIRATIONWINDOW,&best);
+      	value=firstnegamax(10*d,color,lastvalue-window,lastvalue+window,&best);
    		/* check if aspiration holds */
-      	t=clock();
-      	movetonotation(p,best,Lstr,color);
-      	if(value>=lastvalue+ASPIRATIONWINDOW)
+      	if(value>=lastvalue+window)
          	{
          	/*memset(deep,0,HASHSIZEDEEP*sizeof(struct hashentry));*/
 		   	/*memset(shallow,0,HASHSIZESHALLOW*sizeof(struct hashentry));*/
-            if(logging&2)
-       			{
-               printf("\nbest: %s depth %i/%i nodes %u value>%i time %3.2fs",Lstr,d,maxdepth,cake_nodes,value,(t-start)/TICKS);
-            	fflush(stdout);
-               }
-            if(logging&1)
-       			{
-               fprintf(cake_fp,"\nbest: %s depth %i/%i nodes %u value>%i time %3.2fs",Lstr,d,maxdepth,cake_nodes,value,(t-start)/TICKS);
-            	fflush(cake_fp);
-            	}
-#ifndef ANALYSISMODULE
-            sprintf(str,"\nbest: %s depth %i/%i nodes %u value>%i time %3.2fs",Lstr,d,maxdepth,cake_nodes,value,(t-start)/TICKS);
-#endif
+            report(d,value,LOWER,best,color);
           	value=firstnegamax(10*d,color,lastvalue,10000,&best);
             if(value<=lastvalue)
       			value=firstnegamax(10*d,color,-10000,10000,&best);
-      		movetonotation(p,best,Lstr,color);
          	}
-      	if(value<=lastvalue-ASPIRATIONWINDOW)
+      	if(value<=lastvalue-window)
          	{
         		/*memset(deep,0,HASHSIZEDEEP*sizeof(struct hashentry));*/
 		   	/*memset(shallow,0,HASHSIZESHALLOW*sizeof(struct hashentry));*/
-         	if(logging&2)
-            	{
-               printf("\nbest: %s depth %i/%i nodes %u value<%i time %3.2fs",Lstr,d,maxdepth,cake_nodes,value,(t-start)/TICKS);
-            	fflush(stdout);
-               }
-            if(logging&1)
-            	{
-               fprintf(cake_fp,"\nbest: %s depth %i/%i nodes %u value<%i time %3.2fs",Lstr,d,maxdepth,cake_nodes,value,(t-start)/TICKS);
-            	fflush(cake_fp);
-               }
-#ifndef ANALYSISMODULE
-            sprintf(str,"\nbest: %s depth %i/%i nodes %u value<%i time %3.2fs",Lstr,d,maxdepth,cake_nodes,value,(t-start)/TICKS);
-#endif
+            report(d,value,UPPER,best,color);
          	value=firstnegamax(10*d,color,-10000,lastvalue,&best);
             if(value>=lastvalue)
          		value=firstnegamax(10*d,color,-10000,10000,&best);
-         	movetonotation(p,best,Lstr,color);
          	}
+     		t=walltime();
+     		nodes=searchnodes();
 
-
-     		t=clock();
-#ifndef ANALYSISMODULE
-	if(t-start>0)
-     		sprintf(str,"best: %s depth %i/%i nodes %u value %i time %3.2fs %4.0fkN/s db %i",Lstr,d,maxdepth,cake_nodes,value,(t-start)/TICKS,cake_nodes/1000/(t-start)*TICKS,dblookups);
-	else
-     		sprintf(str,"best: %s depth %i/%i nodes %u value %i time %3.2fs ?kN/s db %i",Lstr,d,maxdepth,cake_nodes,value,(t-start)/TICKS,dblookups);
-
-#endif
-         if(logging&1)
-         	{
-            fprintf(cake_fp,"\n%s",str);
-            fflush(cake_fp);
-         	}
-         if(logging&2)
+         /* an interrupt has to be handled before any of the tests below ends the search */
+      	if(atomicget(Gstop))
          	{
-            printf("\n%s",str);
-            fflush(stdout);
+            /* stop the search. don't use the best move & value because they are rubbish */
+            best=last;
+            movetonotation(p,best,Lstr,color);
+            value=lastvalue;
+            sprintf(str,"interrupt: best %s value %i",Lstr,value);
+            interrupted=1;
+            break;
             }
-
+         report(d,value,EXACT,best,color);
+         if(Gmultipv>1) getlines(color);
+         if(Gstats.iterations<MAXITERATIONS)
+         	Gstats.iternodes[Gstats.iterations++]=nodes-lastnodes;
+         lastnodes=nodes;
+         Gstats.depth=d;
 
          if(how==0)
-         	/* time mode: if time>maxtime/2 stop search. if time>2*maxtime then a
-            test in 'negamax' will set *play to 1
-            therefore, cake++ returns in the interval [MT/2,2*MT] */
-     			{if( (clock()-start)/TICKS>(maxtime/2)) break;}
+         	{
+            /* time mode: the next iteration costs about as much more as this one
+            	cost more than the last one. don't start it if it can't finish */
+            elapsed=searchtime();
+            itertime=elapsed-iterstart;
+            if(lastitertime>0.001)
+            	{
+               branch=itertime/lastitertime;
+               if(branch<BRANCHMIN) branch=BRANCHMIN;
+               if(branch>BRANCHMAX) branch=BRANCHMAX;
+               }
+            else
+            	branch=BRANCHDEFAULT;
+            lastitertime=itertime;
+            Ghardtime=(long long)(TIMEHARD*maxtime*1e9);
+            if(elapsed+branch*itertime>maxtime) break;
+            /* an easy move: the best move has not changed and the others were
+            	refuted with next to no effort */
+            if(d>1 && Gbestshare>EASYSHARE && elapsed>EASYTIME*maxtime &&
+            	best.bm==last.bm && best.bk==last.bk && best.wm==last.wm && best.wk==last.wk) break;
+            }
          if(how==1)
          	{if(d>=depthtosearch) break;}
          if(how==2)
-         	{if(cake_nodes>maxnodes) break;}
+         	{if(nodes>maxnodes) break;}
 #ifdef IMMEDIATERETURNONFORCED
       	if(n==1) break;
 #endif
-      	if(abs(value)>4500) break;
-      	if(*play)
-         	{
-            /* stop the search. don't use the best move & value because they are rubbish */
-            best=last;
-            movetonotation(p,best,Lstr,color);
-            value=lastvalue;
-#ifndef ANALYSISMODULE
-            sprintf(str,"interrupt: best %s value %i",Lstr,value);
-#endif
-            break;
-            }
+      	if(abs(value)>MATEVALUE) break;
          lastvalue=value; /* save the value for this iteration */
          last=best; /* save the best move on this iteration */
      		}
+   /* the result is the last complete iteration */
+   info.depth=Gstats.depth;
+   info.seldepth=maxdepth;
+   info.value=value;
+   info.bound=EXACT;
+   info.nodes=nodes;
+   info.time=t-start;
+   info.color=color;
+   info.pv[0]=best;
+   if(!interrupted)
+   	infostring(str,p,&info,Gstats.dbprobes);
+#ifdef SMP
+   smpstop();
+#endif
+   nodes=searchnodes();
+   Gstats.nodes=nodes;
+   Gstats.time=walltime()-start;
+   Gstats.nps=Gstats.time>0 ? nodes/Gstats.time : 0;
+   if(maxdepth>Gstats.seldepth) Gstats.seldepth=maxdepth;
+   Gstats.value=value;
+   if(atomicget(&e->stop))
+   	{
+      Gstats.stopped=1;
+      Gstats.stoplatency=(double)(nanotime()-atomicget64(&e->stoprequest))/1e9;
+      }
+   e->stats=Gstats;
+   writestats(e);
 #ifdef REPCHECK
-	Ghistory[HISTORYOFFSET-2]=p;
+   root=p;
 #endif
    getpv(Lstr,color);
-#ifndef ANALYSISMODULE
    strcat(str," pv: ");
-   strcat(str,Lstr);
-   strcpy(tempstr,"");
-   strcat(tempstr,str);
-
-   sprintf(str,tempstr);
-#endif
-   if(!(*play))
-   	{togglemove(best);}
-   else
-   	{togglemove(last);}
+   strncat(str,Lstr,254-strlen(str));
 	if(logging&1)
    	{
-      fprintf(cake_fp,"\nPV: %s\n",Lstr);
-      fflush(cake_fp);
+      info.npv=getpvmoves(info.pv,MAXPV,color);
+      writelog(LOGRESULT,p,color,value,&info);
       }
+   /* play the move which str and value describe. a stop which comes after the
+   	last iteration has finished changes nothing */
+   if(!interrupted)
+   	{togglemove(best);}
+   else
+   	{togglemove(last);}
    if(logging&2)
    	{
       printf("\nPV: %s\n",Lstr);
       fflush(stdout);
       }
-      #ifdef REPCHECK
-	Ghistory[HISTORYOFFSET-1]=p;
+#ifdef REPCHECK
+   /* the game goes on with the root and the move played */
+   memcpy(e->gamehistory,Ghistory+2,sizeof(e->gamehistory));
+   absolutehashkey();
+   e->gamehistory[HISTORYOFFSET-1].key=repkey();
+   if(reversible(&root,&p))
+   	e->gamehistory[HISTORYOFFSET-1].reversible=e->gamehistory[HISTORYOFFSET-2].reversible+1;
+   else
+   	e->gamehistory[HISTORYOFFSET-1].reversible=0;
+   e->gamelast=p;
+#endif
+   e->nodes=nodes;
+   memcpy(e->history,history,sizeof(history));
+   e->historytotal=historytotal;
+#ifdef MOCOUNTER
+   memcpy(e->countermoves,Gcountermoves,sizeof(Gcountermoves));
 #endif
    *position=p;
-   if(logging&1) fclose(cake_fp);
    return value;
    }
 
+#ifdef PONDER
+#ifdef SYS_WINDOWS
+static DWORD WINAPI ponderthreadproc(LPVOID arg)
+#else
+static void *ponderthreadproc(void *arg)
+#endif
+	{
+   struct cakeengine *e=arg;
+
+   Gponder=1;
+   e->pondervalue=cake_enginegetmove(e,&e->ponderpos,e->pondercolor,e->ponderhow,e->pondermaxtime,e->ponderdepth,
+   											 e->pondermaxnodes,e->ponderstr,NULL,e->ponderlog,0);
+#ifdef SYS_WINDOWS
+   return 0;
+#else
+   return NULL;
+#endif
+   }
+
+int cake_ponder(struct cakeengine *e, struct pos *position, int color, int how, double maximaltime,
+					 int depthtosearch, int32 maxnodes, int log, struct pos *expected)
+	{
+   /* position is what cake_enginegetmove returned and color the side to move
+   	in it. take the reply from the pv in the hashtable and start searching the
+      position after it on a thread of its own, with the same parameters the next
+      cake_enginegetmove would get. the position after the reply is written to
+      expected, the caller then reports cake_ponderhit or cake_pondermiss */
+   struct move movelist[MAXMOVES];
+   int32 forcefirst=0;
+   int dummy=0;
+   int i,n;
+#ifndef SYS_WINDOWS
+   pthread_attr_t attr;
+#endif
+
+   if(e==NULL) e=cake_default;
+   cake_pondermiss(e);
+   Gengine=e;
+   deep=e->deep;
+   shallow=e->shallow;
+   p=*position;
+   realdepth=0;
+   absolutehashkey();
+   hashlookup(&dummy,&dummy,&dummy,0,&forcefirst,color);
+   if(forcefirst==0) return 0;
+   n=makecapturelist(movelist,color,forcefirst);
+   if(!n)
+   	n=makemovelist(movelist,color,forcefirst,NULL,0);
+   for(i=0;i<n;i++)
+   	{
+      if(color==BLACK && (movelist[i].bm|movelist[i].bk)==forcefirst) break;
+      if(color==WHITE && (movelist[i].wm|movelist[i].wk)==forcefirst) break;
+      }
+   if(i>=n) return 0;
+   togglemove(movelist[i]);
+   e->ponderpos=p;
+   if(expected!=NULL) *expected=p;
+
+   e->pondercolor=color^CC;
+   e->ponderhow=how;
+   e->pondermaxtime=maximaltime;
+   e->ponderdepth=depthtosearch;
+   e->pondermaxnodes=maxnodes;
+   e->ponderlog=log;
+#ifdef REPCHECK
+   memcpy(e->pondergamehistory,e->gamehistory,sizeof(e->gamehistory));
+   e->pondergamelast=e->gamelast;
+#endif
+   atomicset(&e->stop,0);
+   e->pondering=1;
+   e->ponderactive=1;
+#ifdef SYS_WINDOWS
+   e->ponderhandle=CreateThread(NULL,SMPSTACKSIZE,ponderthreadproc,e,0,NULL);
+   i=e->ponderhandle!=NULL;
+#else
+   pthread_attr_init(&attr);
+   pthread_attr_setstacksize(&attr,SMPSTACKSIZE);
+   i=pthread_create(&e->ponderhandle,&attr,ponderthreadproc,e)==0;
+   pthread_attr_destroy(&attr);
+#endif
+   if(!i)
+   	{
+      /* no ponder thread: the caller searches as if it had never pondered */
+      e->ponderactive=0;
+      e->pondering=0;
+      return 0;
+      }
+   return 1;
+   }
+
+static void ponderjoin(struct cakeengine *e)
+	{
+#ifdef SYS_WINDOWS
+   WaitForSingleObject(e->ponderhandle,INFINITE);
+   CloseHandle(e->ponderhandle);
+#else
+   pthread_join(e->ponderhandle,NULL);
+#endif
+   e->ponderactive=0;
+   e->pondering=0;
+   }
+
+int cake_ponderhit(struct cakeengine *e, struct pos *position, char str[255])
+	{
+   /* the opponent played the expected move: the ponder search becomes the real
+   	search and keeps everything it has found. its clock starts now. waits for it
+      to finish and returns like cake_enginegetmove */
+   if(e==NULL) e=cake_default;
+   if(!e->ponderactive) return 0;
+   atomicset64(&e->ponderhittime,nanotime());
+   atomicset(&e->pondering,0);
+   ponderjoin(e);
+   *position=e->ponderpos;
+   strcpy(str,e->ponderstr);
+   if(e==cake_default) cake_nodes=e->nodes;
+   return e->pondervalue;
+   }
+
+void cake_pondermiss(struct cakeengine *e)
+	{
+   /* the opponent played something else: stop the ponder search and forget
+   	that it ever happened */
+   if(e==NULL) e=cake_default;
+   if(e==NULL || !e->ponderactive) return;
+   cake_stop(e);
+   ponderjoin(e);
+#ifdef REPCHECK
+   memcpy(e->gamehistory,e->pondergamehistory,sizeof(e->gamehistory));
+   e->gamelast=e->pondergamelast;
+#endif
+   }
+#endif
+
+struct cakebatch   /* the jobs of cake_analyze() and the next one to hand out */
+	{
+   struct cakejob *jobs;
+   int n;
+   int next;
+#ifdef SYS_WINDOWS
+   CRITICAL_SECTION lock;
+#else
+   pthread_mutex_t lock;
+#endif
+   };
+
+static int nextjob(struct cakebatch *b)
+	{
+   int i;
+
+#ifdef SYS_WINDOWS
+   EnterCriticalSection(&b->lock);
+#else
+   pthread_mutex_lock(&b->lock);
+#endif
+   i=b->next;
+   if(i<b->n) b->next++;
+#ifdef SYS_WINDOWS
+   LeaveCriticalSection(&b->lock);
+#else
+   pthread_mutex_unlock(&b->lock);
+#endif
+   return i;
+   }
+
+#ifdef SYS_WINDOWS
+static DWORD WINAPI batchthreadproc(LPVOID arg)
+#else
+static void *batchthreadproc(void *arg)
+#endif
+	{
+   /* one thread of cake_analyze: take the next job until there are none left.
+   	every job is searched from an empty hashtable and without game history,
+      so that its result does not depend on which thread searched it. the
+      engine is new, so only the jobs after the first have to clear the tables.
+      the book is off: every job is searched and its pv is in the hashtable */
+   struct cakebatch *b=arg;
+   struct cakeengine *e;
+   struct cakejob *job;
+   int i,searched=0;
+
+   e=cake_createengine(0);
+   if(e!=NULL)
+   	{
+      cake_setbook(e,0);
+      while((i=nextjob(b))<b->n)
+      	{
+         job=&b->jobs[i];
+#ifdef REPCHECK
+         memset(e->gamehistory,0,sizeof(e->gamehistory));
+         memset(&e->gamelast,0,sizeof(e->gamelast));
+#endif
+         job->result=job->position;
+         job->value=cake_enginegetmove(e,&job->result,job->color,job->how,job->maxtime,job->depth,
+         										job->maxnodes,job->str,NULL,0,searched);
+         job->stats=e->stats;
+         /* the pv is still in the hashtable of the engine */
+         p=job->position;
+         realdepth=0;
+         job->npv=getpvmoves(job->pv,MAXPV,job->color);
+         searched=1;
+         }
+      cake_destroyengine(e);
+      }
+#ifdef SYS_WINDOWS
+   return 0;
+#else
+   return NULL;
+#endif
+   }
+
+int cake_analyze(struct cakejob jobs[], int n, int threads)
+	{
+   /* search the positions of jobs[0..n-1], each one on its own, and fill in the
+   	results. threads threads with an engine each take the jobs one after the
+      other, without the book. returns the number of jobs searched, less than n
+      only if there was not enough memory for the engines */
+   struct cakebatch b;
+#ifdef SYS_WINDOWS
+   HANDLE handles[MAXTHREADS];
+#else
+   pthread_t handles[MAXTHREADS];
+   pthread_attr_t attr;
+#endif
+   int i,started=0;
+
+   cakeglobalinit();
+   if(threads<1) threads=1;
+   if(threads>MAXTHREADS) threads=MAXTHREADS;
+   if(threads>n) threads=n;
+   if(n<1) return 0;
+   b.jobs=jobs;
+   b.n=n;
+   b.next=0;
+#ifdef SYS_WINDOWS
+   InitializeCriticalSection(&b.lock);
+   for(i=0;i<threads;i++)
+   	{
+      handles[started]=CreateThread(NULL,SMPSTACKSIZE,batchthreadproc,&b,0,NULL);
+      if(handles[started]!=NULL) started++;
+      }
+   for(i=0;i<started;i++)
+   	{
+      WaitForSingleObject(handles[i],INFINITE);
+      CloseHandle(handles[i]);
+      }
+   DeleteCriticalSection(&b.lock);
+#else
+   pthread_mutex_init(&b.lock,NULL);
+   pthread_attr_init(&attr);
+   pthread_attr_setstacksize(&attr,SMPSTACKSIZE);
+   for(i=0;i<threads;i++)
+   	if(pthread_create(&handles[started],&attr,batchthreadproc,&b)==0) started++;
+   pthread_attr_destroy(&attr);
+   for(i=0;i<started;i++)
+   	pthread_join(handles[i],NULL);
+   pthread_mutex_destroy(&b.lock);
+#endif
+   /* a thread only takes jobs once it has its engine, so all jobs which
+   	were handed out have been searched */
+   return b.next;
+   }
+
 
 
    
@@ -560,51 +2284,49 @@ bookmovetomove(int32 bookmove, struct move *best, struct pos *p, int color)
 
 /*-----------------------------------------------------------------------------*/
 
-#ifndef ANALYSISMODULE
 int firstnegamax(int d, int color, int alpha, int beta, struct move *best)
 	{
-   int i,value,swap=0;
-   static int n;
-   int capture;
-   static struct move movelist[MAXMOVES];
-   int32 l_bm,l_bk,l_wm,l_wk;
-   int32 Lkey,Llock;
+   int i,k,value,swap=0;
+   static THREADLOCAL int n;
+   static THREADLOCAL struct move movelist[MAXMOVES];
    int Lalpha=alpha,Lbeta=beta;
+   int hashalpha=alpha,hashbeta=beta;
    int32 forcefirst=0;
-   int32 Lkiller=0;
-   static struct pos last;
+   static THREADLOCAL struct pos last;
    struct move tmpmove;
    int values[MAXMOVES]; /* holds the values of the respective moves - use to order */
+   static THREADLOCAL unsigned int movenodes[MAXMOVES]; /* size of the subtree of each move */
+   unsigned int nodes,total;
 
-   if(*play) return 0;
-   cake_nodes++;
+   if(atomicget(Gstop)) return 0;
+   Gnodes++;
 
-	/* search the current position in the hashtable */
-   hashlookup(&value,&alpha,&beta,d,&forcefirst, color);
+	/* search the current position in the hashtable. multi-pv needs the
+   	full window and only takes the move */
+   if(Gmultipv>1)
+   	hashlookup(&value,&hashalpha,&hashbeta,d,&forcefirst, color);
+   else
+   	hashlookup(&value,&alpha,&beta,d,&forcefirst, color);
 
-   /* check for a capture move */
-   capture = testcapture(color);
+   /* moves which are not searched, after a cutoff, count as the worst and
+   	have no nodes in this iteration */
+   for(i=0;i<MAXMOVES;i++)
+   	{
+   	values[i]=-10000;
+      movenodes[i]=0;
+      }
 
 	if(last.bm==p.bm && last.bk==p.bk && last.wm==p.wm && last.wk==p.wk)
    	/* then we are still looking at the same position - no need to
       	regenerate the movelist */    ;
    else
    	{
-      for(i=0;i<MAXMOVES;i++)
-      	values[i]=color==BLACK?-10000:10000;
    	n=makecapturelist(movelist,color,forcefirst);
-   	capture=n;
       if(n==0)
-   		n=makemovelist(movelist,color,forcefirst,0);
+   		n=makemovelist(movelist,color,forcefirst,NULL,0);
    	if(n==0)
-   		return -5000+realdepth;
+   		return -MATE+realdepth;
       }
-   /* save old hashkey */
-   Lkey=Gkey;
-   Llock=Glock;
-
-   /* save old material balance */
-   l_bm=bm;l_bk=bk;l_wm=wm;l_wk=wk;
    *best=movelist[0];
 
    for(i=0;i<n;i++)
@@ -613,62 +2335,125 @@ int firstnegamax(int d, int color, int alpha, int beta, struct move *best)
    	printf(out,"best: %s depth %i/%i nodes %i value %i ",Lstr,d,maxdepth,cake_nodes,value);
       movetonotation(p,movelist[i],Lstr,color);
       strcat(out, Lstr); */
-      togglemove(movelist[i]);
-      if(color==BLACK)
-        	{
-         if(capture)
+      domove(movelist[i],color);
+      nodes=Gnodes;
+
+      /********************recursion********************/
+      if(Gmultipv>1)
+      	{
+         /* the first multipv moves are searched with the window of the
+         	iteration, not raised by the moves before them, so that each gets
+            an exact value. every other move is tested against the worst of
+            the best multipv moves so far and only searched exactly if it is better */
+         if(i<Gmultipv)
+         	value=-negamax(d-10,color^CC,-beta,-Lalpha,0);
+         else
          	{
-            wm-=recbitcount(movelist[i].wm);
-         	wk-=recbitcount(movelist[i].wk);
+            k=kthvalue(values,i,Gmultipv);
+            if(k<Lalpha) k=Lalpha;
+            value=-negamax(d-10,color^CC,-k-1,-k,0);
+            if(value>k)
+            	value=-negamax(d-10,color^CC,-beta,-k,0);
             }
-         bk+=isprom(movelist[i].info);
-         bm-=isprom(movelist[i].info);
          }
       else
-       	{
-         if(capture)
-         	{
-            bm-=recbitcount(movelist[i].bm);
-         	bk-=recbitcount(movelist[i].bk);
-            }
-         wk+=isprom(movelist[i].info);
-         wm-=isprom(movelist[i].info);
+#ifdef PVS
+      if(i==0)
+      	value=-negamax(d-10,color^CC,-beta,-alpha,0);
+      else
+      	{
+         value=-negamax(d-10,color^CC,-alpha-1,-alpha,0);
+         if(value>alpha && value<beta)
+         	value=-negamax(d-10,color^CC,-beta,-alpha,0);
          }
-      realdepth++;
-		/*update the hash key*/
-      updatehashkey(movelist[i]);
-
-#ifdef REPCHECK
-      Ghistory[realdepth+HISTORYOFFSET]=p;
+#else
+      value=-negamax(d-10,color^CC,-beta,-alpha,0);
 #endif
-
-      /********************recursion********************/
-      value=-negamax(d-10,color^CC,-beta,-alpha,&Lkiller,0);
       /*************************************************/
       values[i]=value;
-      realdepth--;
-      togglemove(movelist[i]);
-      /* restore the old hash key*/
-      Gkey=Lkey;
-      Glock=Llock;
-      /* restore the old material balance */
-      bm=l_bm;bk=l_bk;wm=l_wm;wk=l_wk;
+      movenodes[i]=Gnodes-nodes;
+      undomove(movelist[i]);
 
       if(value>=beta) {*best=movelist[i];alpha=value;swap=i;break;}
-      if(value>alpha) {*best=movelist[i];alpha=value;swap=i;}
+      if(value>alpha)
+      	{
+         *best=movelist[i];alpha=value;swap=i;
+         /* another move is best: tell the caller, not only after the iteration */
+         if(i>0 && Gpoll && Gengine->info!=NULL && !atomicget(Gstop))
+         	report(d/10,value,EXACT,*best,color);
+         }
       }
 	/* save the position in the hashtable */
    hashstore(alpha,Lalpha,Lbeta,d,*best,color);
-   /* and order the movelist */
-  	if(swap!=0)
+   if(Gmultipv>1)
+   	{
+      /* order the whole movelist by value so that the best moves are
+      	searched first next time, and keep the best multipv of them */
+      if(!atomicget(Gstop))
+      	{
+         for(i=0;i<n;i++)
+         	{
+            for(k=0;k<n-1;k++)
+            	{
+               if(values[k]<values[k+1])
+               	{
+                  swap=values[k];
+                  values[k]=values[k+1];
+                  values[k+1]=swap;
+                  tmpmove=movelist[k];
+                  movelist[k]=movelist[k+1];
+                  movelist[k+1]=tmpmove;
+                  nodes=movenodes[k];
+                  movenodes[k]=movenodes[k+1];
+                  movenodes[k+1]=nodes;
+                  }
+               }
+            }
+         for(Gmultipvn=0;Gmultipvn<n && Gmultipvn<Gmultipv;Gmultipvn++)
+         	{
+            Gmultipvmoves[Gmultipvn]=movelist[Gmultipvn];
+            Gmultipvvalues[Gmultipvn]=values[Gmultipvn];
+            }
+         }
+      }
+   else
    	{
-      tmpmove=movelist[swap];
-      for(i=swap;i>0;i--)
+      /* and order the movelist: the best move first, the others by the size
+      	of their subtrees. a move which was hard to refute is the most likely
+         one to become best in the next iteration */
+   	if(swap!=0)
+   		{
+      	tmpmove=movelist[swap];
+         nodes=movenodes[swap];
+      	for(i=swap;i>0;i--)
+      		{
+         	movelist[i]=movelist[i-1];
+            movenodes[i]=movenodes[i-1];
+         	}
+      	movelist[0]=tmpmove;
+         movenodes[0]=nodes;
+      	}
+      for(i=1;i<n;i++)
       	{
-         movelist[i]=movelist[i-1];
+         for(k=1;k<n-1;k++)
+         	{
+            if(movenodes[k]<movenodes[k+1])
+            	{
+               tmpmove=movelist[k];
+               movelist[k]=movelist[k+1];
+               movelist[k+1]=tmpmove;
+               nodes=movenodes[k];
+               movenodes[k]=movenodes[k+1];
+               movenodes[k+1]=nodes;
+               }
+            }
          }
-      movelist[0]=tmpmove;
       }
+   /* the share of the best move in the nodes of this iteration, for the time manager */
+   total=0;
+   for(i=0;i<n;i++)
+   	total+=movenodes[i];
+   Gbestshare=total ? (double)movenodes[0]/(double)total : 0;
   	/* to check how the movelist is doing, print it */
    /*printf("\n");
   	for(i=0;i<n;i++)
@@ -678,151 +2463,230 @@ int firstnegamax(int d, int color, int alpha, int beta, struct move *best)
       }*/
    /* save position to check it on next entry because of movelist*/
    last=p;
+#ifdef TREELOG
+   /* the root of every iteration closes its tree */
+   if(Gtree!=NULL && !atomicget(Gstop))
+   	{
+      treecutoff(alpha>=Lbeta ? TREEBETA : TREEMOVES,Gmultipv>1 ? TREENOMOVE : swap);
+      treerecord(d,color,Lalpha,Lbeta,alpha);
+      }
+#endif
    return alpha;
    }
 
-#else  /* this is the analysis version of cake++ */
-int firstnegamax(int d, int color, int alpha, int beta, struct move *best)
+#ifdef USEDB
+static INLINE int dblookup(int color)
 	{
-   int i,j,value,capture,swap=0;
-   static int n;
-   static struct move movelist[MAXMOVES];
-   int32 l_bm,l_bk,l_wm,l_wk;
-   int32 Lkey,Llock;
-   int Lalpha=alpha,Lbeta=beta;
-/*   char Lstr[256];*/
-   int32 forcefirst=0;
-   int32 Lkiller=0;
-   static struct pos last;
-   struct move tmpmove;
-   char Lstr[255];
-   static int values[MAXMOVES]; /* holds the values of the respective moves - use to order */
-   							 /* and since this is the analysis module, also used to diplay values of
-                            all moves */
+   /* the database value of the position if it is in the database and there
+   	are no captures for the side not to move, UNKNOWN otherwise. the side
+      to move must not have a capture either */
+   int dbresult;
 
+   if(bk+bm+wk+wm>maxNdb) return UNKNOWN;
+   if(bk+bm==0 || wk+wm==0) return UNKNOWN;
+   if(testcapture(color^CC)) return UNKNOWN;
+   /* found a position which should be in the database */
+   Gstats.dbprobes++;
+   struct pos posforlookup = {.bm = p.bm, .bk = p.bk, .wm = p.wm, .wk = p.wk };
+   dbresult = lookup(&posforlookup, color);
+//   dbresult=DBLookup(p,(color)>>1);
+   if(dbresult!=UNKNOWN) Gstats.dbhits++;
+   return dbresult;
+   }
+#endif
 
-   if(*play) return 0;
-   cake_nodes++;
-	/* search the current position in the hashtable */
-   /*hashlookup(&value,&alpha,&beta,d,&forcefirst, color);  */
+#ifdef TREELOG
+static int quiescencenode(int color, int alpha, int beta);
 
-	if(last.bm==p.bm && last.bk==p.bk && last.wm==p.wm && last.wk==p.wk)
-   	/* then we are still looking at the same position - no need to
-      	regenerate the movelist */  ;
-   else
-   	{
-      /*for(i=0;i<MAXMOVES;i++)
-      	values[i]=color==BLACK?-10000:10000; */
-   	n=makecapturelist(movelist,color,forcefirst);
-   	capture=n;
-      if(n==0)
-   		n=makemovelist(movelist,color,forcefirst,0);
-   	if(n==0)
-   		return -5000+realdepth;
-      }
+static int quiescence(int color, int alpha, int beta)
+	{
+   /* quiescencenode and a record of the node. a search of the same position
+   	from within the node, like iid, must not change why the node returns */
+   int value;
+   int8 cutoff=Gtreecutoff[realdepth],move=Gtreemove[realdepth];
 
-   /* save old hashkey */
-   Lkey=Gkey;
-   Llock=Glock;
+   if(Gtree==NULL) return quiescencenode(color,alpha,beta);
+   treecutoff(TREEMOVES,TREENOMOVE);
+   value=quiescencenode(color,alpha,beta);
+   if(!atomicget(Gstop)) treerecord(0,color,alpha,beta,value);
+   treecutoff(cutoff,move);
+   return value;
+   }
 
-   /* save old material balance */
-   l_bm=bm;l_bk=bk;l_wm=wm;l_wk=wk;
-   *best=movelist[0];
+static int quiescencenode(int color, int alpha, int beta)
+#else
+static int quiescence(int color, int alpha, int beta)
+#endif
+	{
+   /* the search below depth 0: captures are compulsory, so they are searched
+   	until the position is quiet, and only there evaluation() stands pat.
+      there is no hashtable lookup or store down here: the positions are too
+      many and too short-lived to pay for it */
+   struct move movelist[MAXMOVES];
+   int i,n,value;
+#ifdef USEDB
+   int dbresult;
+#endif
 
-   for(i=0;i<n;i++)
-   	{
-      /*movetonotation(p,*best,Lstr,color);
-   	printf(out,"best: %s depth %i/%i nodes %i value %i ",Lstr,d,maxdepth,cake_nodes,value);
-      movetonotation(p,movelist[i],Lstr,color);
-      strcat(out, Lstr); */
-      togglemove(movelist[i]);
-      if(color==BLACK)
-        	{
-         if(capture)
-         	{
-            wm-=recbitcount(movelist[i].wm);
-         	wk-=recbitcount(movelist[i].wk);
-            }
-         bk+=isprom(movelist[i].info);
-         bm-=isprom(movelist[i].info);
-         }
-      else
-       	{
-         if(capture)
-         	{
-            bm-=recbitcount(movelist[i].bm);
-         	bk-=recbitcount(movelist[i].bk);
-            }
-         wk+=isprom(movelist[i].info);
-         wm-=isprom(movelist[i].info);
-         }
-      realdepth++;
-		/*update the hash key*/
-      updatehashkey(movelist[i]);
+   if(atomicget(Gstop)) return 0;
+   if(realdepth>MAXDEPTH) {treecutoff(TREELEAF,TREENOMOVE);return evaluation(color,alpha,beta);}
+   Gnodes++;
+   if(Gpoll && (Gnodes&Gstridemask)==0) pollstop();
+#ifdef MATEPRUNING
+   if(matedistance(&alpha,&beta)) {treecutoff(TREEMATE,TREENOMOVE);return alpha;}
+#endif
 
+   n=makecapturelist(movelist,color,0);
+   if(n==0)
+   	{
+      if(realdepth>maxdepth) maxdepth=realdepth;
 #ifdef REPCHECK
-      Ghistory[realdepth+HISTORYOFFSET]=p;
+      /* a quiet position can be a repetition */
+      if(bk && wk && repetition())
+      	{treecutoff(TREEREPETITION,TREENOMOVE);return 0;}
+#endif
+#ifdef USEDB
+      dbresult=dblookup(color);
+      if(dbresult==DRAW)
+      	{treecutoff(TREEDB,TREENOMOVE);return 0;}
+      if(dbresult==WIN)
+      	{
+         value=dbwineval(color);
+         if(value>=beta) {treecutoff(TREEDB,TREENOMOVE);return value;}
+         }
 #endif
+      /* stand pat */
+      value=evaluation(color,alpha,beta);
+#ifdef EXTENDALL
+      /* unless the side not to move has a capture and the stand pat value is
+      	within QLEVEL of the window: then the side to move may answer it */
+      if(value>beta+QLEVEL || value<alpha-QLEVEL || !testcapture(color^CC))
+      	{treecutoff(TREELEAF,TREENOMOVE);return value;}
+      n=makemovelist(movelist,color,0,NULL,0);
+      if(n==0)
+      	{treecutoff(TREEMATE,TREENOMOVE);return -MATE+realdepth;}
+      Gstats.extensions++;
+#else
+      treecutoff(TREELEAF,TREENOMOVE);
+      return value;
+#endif
+      }
 
-      /********************recursion********************/
-      value=-negamax(d-10,color^CC,-10000,10000,&Lkiller,0);
-      /*************************************************/
-      values[i]=value;
-      /* output new list of moves with values in str */
+   for(i=0;i<n;i++)
+   	{
+      domove(movelist[i],color);
+      value=-quiescence(color^CC,-beta,-alpha);
+      undomove(movelist[i]);
+      if(value>=beta) {treecutoff(TREEBETA,i);return value;}
+      if(value>alpha) {alpha=value;treecutoff(TREEMOVES,i);}
+      }
+   return alpha;
+   }
 
-      realdepth--;
-      togglemove(movelist[i]);
-      /* restore the old hash key*/
-      Gkey=Lkey;
-      Glock=Llock;
-      /* restore the old material balance */
-      bm=l_bm;bk=l_bk;wm=l_wm;wk=l_wk;
+#ifdef MOHISTORY
+static INLINE void historybonus(struct move m, int color, int d)
+	{
+   /* m produced a cutoff with remaining depth d: the deeper, the more it counts */
+   int32 from,to,bonus;
 
-      sprintf(out,"d %i: ",(int)d/10);
-      for(j=0;j<n;j++)
-      	{
-			movetonotation(p,movelist[j],Lstr,color);
-         strcat(out,Lstr);
-         strcat(out,":");
-         sprintf(Lstr,"%i   ",values[j]);
-         strcat(out,Lstr);
-         }
+   if(color==BLACK)
+   	{
+      from=(m.bm|m.bk)&(p.bm|p.bk);
+      to=(m.bm|m.bk)&(~(p.bm|p.bk));
+      }
+   else
+   	{
+      from=(m.wm|m.wk)&(p.wm|p.wk);
+      to=(m.wm|m.wk)&(~(p.wm|p.wk));
+      }
+   from=lastbit(from);
+   to=lastbit(to);
+   if(from>31 || to>31) return;
+   bonus=(d>=10) ? (d/10)*(d/10) : 1;
+   history[from][to]+=bonus;
+   historytotal+=bonus;
+   if(historytotal>HISTORYMAX) agehistory();
+   }
+#endif
 
+#ifdef MOCOUNTER
+static INLINE int32 *countermove(int color)
+	{
+   /* the countermove entry of the opponent's last move, NULL at the root */
+   struct undo *u;
+   int32 before,after,from,to;
 
-      if(value>=beta) {*best=movelist[i];swap=i;/*break;*/}
-      if(value>alpha) {*best=movelist[i];swap=i;alpha=value;}
+   if(realdepth==0) return NULL;
+   u=&Gundo[realdepth-1];
+   if(color==BLACK)
+   	{
+      before=u->wm|u->wk;
+      after=p.wm|p.wk;
       }
-	/* save the position in the hashtable */
-   hashstore(alpha,Lalpha,Lbeta,d,*best,color);
-   /* and order the movelist with a bubblesort*/
-   for(i=0;i<n;i++)
+   else
    	{
-      for(j=0;j<n-1;j++)
-      	{
-         if(values[j]<values[j+1])
-         	{
-            swap=values[j];
-            values[j]=values[j+1];
-            values[j+1]=swap;
-            tmpmove=movelist[j];
-            movelist[j]=movelist[j+1];
-            movelist[j+1]=tmpmove;
-            }
-         }
+      before=u->bm|u->bk;
+      after=p.bm|p.bk;
       }
-   last=p;
-   return alpha;
+   from=lastbit(before&~after);
+   to=lastbit(after&~before);
+   if(from>31 || to>31) return NULL;
+   return &Gcountermoves[from][to];
+   }
+#endif
+
+#ifdef MOKILLER
+static INLINE void storekiller(struct move m, int color)
+	{
+   /* m produced a cutoff on this ply: it becomes the first killer, the old
+   	first killer the second one */
+   int32 k;
 
+   if(color==BLACK)
+   	k=m.bm|m.bk;
+   else
+   	k=m.wm|m.wk;
+   if(Gkillers[realdepth][0]!=k)
+   	{
+      Gkillers[realdepth][1]=Gkillers[realdepth][0];
+      Gkillers[realdepth][0]=k;
+      }
    }
 #endif
 
-int negamax(int d, int color, int alpha, int beta, int32 *protokiller, int truncationdepth)
-	/* negamax sets *protokiller to the best move compressed like in the hashtable */
-   /* the calling negamax gets a best move in this way. by passing it on in further */
-   /* calls it can be used as a killer */
+#ifdef TREELOG
+static int negamaxnode(int d, int color, int alpha, int beta, int truncationdepth);
+
+int negamax(int d, int color, int alpha, int beta, int truncationdepth)
+	{
+   /* negamaxnode and a record of the node. below depth 0 negamaxnode only calls
+   	quiescence, which records the node itself */
+   int value;
+   int8 cutoff=Gtreecutoff[realdepth],move=Gtreemove[realdepth];
+
+   if(Gtree==NULL || (d<=0 && truncationdepth==0)) return negamaxnode(d,color,alpha,beta,truncationdepth);
+   treecutoff(TREEMOVES,TREENOMOVE);
+   value=negamaxnode(d,color,alpha,beta,truncationdepth);
+   if(!atomicget(Gstop)) treerecord(d,color,alpha,beta,value);
+   treecutoff(cutoff,move);
+   return value;
+   }
+
+static int negamaxnode(int d, int color, int alpha, int beta, int truncationdepth)
+#else
+int negamax(int d, int color, int alpha, int beta, int truncationdepth)
+#endif
 	{
    int i,n,value,capture,v1,v2;
-   int l_bm,l_bk,l_wm,l_wk;
+#ifdef PROBCUT
+   int bound;
+#endif
+#ifdef IID
+   int IIDalpha,IIDbeta;
+#endif
+#ifdef MOCOUNTER
+   int32 *counter=NULL;
+#endif
    int32 forcefirst=0;
    int Lalpha=alpha,Lbeta=beta;
 #ifdef ETC
@@ -830,48 +2694,54 @@ int negamax(int d, int color, int alpha, int beta, int32 *protokiller, int trunc
    int32 ETCdummy;
 #endif
    struct move movelist[MAXMOVES],best;
-   int32 Lkey,Llock;
-   int32 Lkiller=0;
    int dbresult;
-   int allstones;
-
-	/* time check */
-   if((cake_nodes & 0xFFFF)==0)
-   	{
-      if(searchmode==0)
-      	if( (clock()-start)/TICKS>(4*maxtime)) (*play=1);
-      }
+#ifdef LMR
+   int r;
+#endif
 
-	/* return if calculation interrupt */
-   if(*play) return 0;
+	/* return if the search has to stop */
+   if(atomicget(Gstop)) return 0;
+#ifdef SMP
+   /* or if a sibling of a split point above us produced a cutoff */
+   if(Gsplit!=NULL && splitaborted()) return 0;
+#endif
+   /* below depth 0 only captures are searched */
+   if(d<=0 && truncationdepth==0) return quiescence(color,alpha,beta);
    /* stop search if maximal search depth is reached */
-   if(realdepth>MAXDEPTH) return evaluation(color,alpha,beta);
-   cake_nodes++;
+   if(realdepth>MAXDEPTH) {treecutoff(TREELEAF,TREENOMOVE);return evaluation(color,alpha,beta);}
+   Gnodes++;
+   /* time check: the hard deadline */
+   if(Gpoll && (Gnodes&Gstridemask)==0) pollstop();
+#ifdef MATEPRUNING
+   if(matedistance(&alpha,&beta)) {treecutoff(TREEMATE,TREENOMOVE);return alpha;}
+   Lalpha=alpha;
+   Lbeta=beta;
+#endif
 
 	/* search the current position in the hashtable */
    /* only if there is still search depth left! */
    if(d>0)
    	{
       if(hashlookup(&value,&alpha,&beta,d,&forcefirst,color))
-   	return value;
+   	{treecutoff(TREEHASH,TREENOMOVE);return value;}
       }
 #ifdef REPCHECK
 	/* check for repetitions */
-   if(bk && wk)
+   if(bk && wk && repetition())
+   	{treecutoff(TREEREPETITION,TREENOMOVE);return 0;}  /* same position detected! */
+#endif
+#ifdef IID
+   /* no move from the hashtable: a less deep search of this node stores one there.
+   	it has to have depth left, or it only runs the quiescence search, which
+      stores nothing */
+   if(forcefirst==0 && d>IIDREDUCTION && d>=((beta-alpha>1) ? IIDDEPTH : IIDDEPTHNULL) && !testcapture(color))
    	{
-   	for(i=realdepth+HISTORYOFFSET-2;i>=0;i-=2)
-   		{
-      	if((p.bm^Ghistory[i].bm)) break; /* stop repetition search if move with a man is detected */
-      	if((p.wm^Ghistory[i].wm)) break;
-      	if((p.bm==Ghistory[i].bm) && (p.bk==Ghistory[i].bk) && (p.wm==Ghistory[i].wm) && (p.wk==Ghistory[i].wk))
-         	return 0;                     /* same position detected! */
-     		}
+      negamax(d-IIDREDUCTION,color,alpha,beta,truncationdepth);
+      IIDalpha=alpha;
+      IIDbeta=beta;
+      hashlookup(&value,&IIDalpha,&IIDbeta,d,&forcefirst,color);
       }
 #endif
-//#ifdef MOKILLER
-   /* if there is no best move in the hashtable we try the killer move */
-//   if(forcefirst==0) forcefirst=*protokiller;
-//#endif
 #ifdef CHECKCAPTURESINLINE
 	if(testcapture(color))
    	n=makecapturelist(movelist,color,forcefirst);
@@ -884,32 +2754,15 @@ int negamax(int d, int color, int alpha, int beta, int32 *protokiller, int trunc
 
    /* check for database use */
 #ifdef USEDB
-   allstones=bk+bm+wk+wm;
-	if(allstones<=maxNdb)
+	if(capture==0)
    	{
-      if(capture==0)
+      dbresult=dblookup(color);
+      if(dbresult==DRAW)
+      	{treecutoff(TREEDB,TREENOMOVE);return 0;}
+      if(dbresult==WIN)
       	{
-         if(testcapture(color^CC)==0)
-         	{
-            if( (bk+bm>0) && (wk+wm>0))
-            	{
-               /* found a position which should be in the database */
-            	/* no captures are possible */
-               dblookups++;
-                    struct pos posforlookup = {.bm = p.bm, .bk = p.bk, .wm = p.wm, .wk = p.wk };
-                    dbresult = lookup(&posforlookup, color);
-                    
-//                dbresult=DBLookup(p,(color)>>1);
-            	if(dbresult==DRAW)
-            		return 0;
-            	if(dbresult==WIN)
-            		{
-                  value=dbwineval(color);
-                  if(value>=beta) return value;
-                  }
-
-               }
-            }
+         value=dbwineval(color);
+         if(value>=beta) {treecutoff(TREEDB,TREENOMOVE);return value;}
          }
       }
 #endif
@@ -926,6 +2779,7 @@ int negamax(int d, int color, int alpha, int beta, int32 *protokiller, int trunc
    /* truncate or re-expand if the material count is outside / inside eval window */
    if(v1<alpha-TRUNCATEVALUE)
    	{
+      Gstats.truncations++;
       truncationdepth+=Gtruncationdepth;
    	d-=Gtruncationdepth; /* forgot G in versions before 2nd september 1.16 and down */
       }
@@ -933,57 +2787,84 @@ int negamax(int d, int color, int alpha, int beta, int32 *protokiller, int trunc
    	{
    	if(v1>beta+TRUNCATEVALUE)
          {
+         Gstats.truncations++;
    		truncationdepth+=Gtruncationdepth;
          d-=Gtruncationdepth; /* forgot G in versions before 2nd september 1.16 and down */
       	}
       else
       	{
+         if(truncationdepth) Gstats.extensions++;
          d+=truncationdepth;
          truncationdepth=0;
          }
       }
 #endif
 
+#ifdef PROBCUT
+   /* probcut: the value of a search with depth d is about PROBCUTA*v+PROBCUTB, where
+   	v is the value of a search with depth d-PROBCUTREDUCTION. if the shallow search
+      says that the deep search would fail high or low with a margin of PROBCUTT
+      standard deviations, we believe it */
+   if(n==0 && d>=PROBCUTDEPTH && truncationdepth==0 && beta-alpha==1 && abs(beta)<PROBCUTMAXVALUE)
+   	{
+#ifdef PROBCUTLOG
+      /* take a sample instead: search this node with both depths and
+      	an open window, the deep value is exact and can be returned */
+      if(!Gprobcutsample && (Gnodes&PROBCUTSAMPLE)==0)
+      	{
+         Gprobcutsample=1;
+         v2=negamax(d-PROBCUTREDUCTION,color,-10000,10000,truncationdepth);
+         value=negamax(d,color,-10000,10000,truncationdepth);
+         Gprobcutsample=0;
+         if(probcut_fp!=NULL && !atomicget(Gstop) && abs(value)<PROBCUTMAXVALUE && abs(v2)<PROBCUTMAXVALUE)
+         	fprintf(probcut_fp,"%i %i %i\n",d,v2,value);
+         return value;
+         }
+#else
+      /* the bounds are rounded away from the window */
+      bound=1+(int)((beta+PROBCUTT*PROBCUTSIGMA-PROBCUTB)/PROBCUTA);
+      if(negamax(d-PROBCUTREDUCTION,color,bound-1,bound,truncationdepth)>=bound)
+      	{
+         Gstats.probcuts++;
+         treecutoff(TREEPROBCUT,TREENOMOVE);
+         return beta;
+         }
+      bound=(int)((alpha-PROBCUTT*PROBCUTSIGMA-PROBCUTB)/PROBCUTA)-1;
+      if(negamax(d-PROBCUTREDUCTION,color,bound,bound+1,truncationdepth)<=bound)
+      	{
+         Gstats.probcuts++;
+         treecutoff(TREEPROBCUT,TREENOMOVE);
+         return alpha;
+         }
+#endif
+      }
+#endif
+
+
+   /* a truncated node which has run out of depth */
+   if(d<=0) {treecutoff(TREELEAF,TREENOMOVE);return quiescence(color,alpha,beta);}
 
    if(n==0)
       {
-      if(d<=0)
-      	{
-         if(realdepth>maxdepth) maxdepth=realdepth;
-#ifndef EXTENDALL
-         return evaluation(color,alpha,beta);
+#ifdef MOCOUNTER
+      counter=countermove(color);
+      n=makemovelist(movelist,color,forcefirst,Gkillers[realdepth],counter!=NULL ? *counter : 0);
 #else
-			if(testcapture(color^CC)!=0)
-         	/* side not to move has a capture */
-            /* now we test if the side to move is outside the window */
-            {
-            if(v1>beta+QLEVEL)
-         		return evaluation(color,alpha,beta);
-            if(v1<alpha-QLEVEL)
-               return evaluation(color,alpha,beta);
-            /* if the evaluation is in [alpha-QLEVEL,beta+QLEVEL] we extend */
-            }
-         else
-         	return evaluation(color,alpha,beta);
+   	n=makemovelist(movelist,color,forcefirst,Gkillers[realdepth],0);
 #endif
-         }
-   	n=makemovelist(movelist,color,forcefirst,*protokiller);
       }
    if(n==0)
-   	return -5000+realdepth;
+   	{treecutoff(TREEMATE,TREENOMOVE);return -MATE+realdepth;}
 
 
 /* check for single move and extend appropriately */
 	if(n==1)
-   	d+=SINGLEEXTEND;
-
-   /* save old hashkey and old material balance*/
-   Lkey=Gkey;
-   Llock=Glock;
-   l_bm=bm;l_bk=bk;l_wm=wm;l_wk=wk;
+   	{
+      d+=SINGLEEXTEND;
+      Gstats.extensions++;
+      }
 
-   /* for all moves: domove, update hashkey&material, recursion, restore
-      material balance and hashkey, undomove, do alphabetatest */
+   /* for all moves: domove, recursion, undomove, do alphabetatest */
    best=movelist[0];
 
 #ifdef ETC
@@ -994,10 +2875,7 @@ if yes, we don't have to search */
    	{
       for(i=0;i<n;i++)
       	{
-         /* do move */
-         togglemove(movelist[i]);
-         /* update hashkey */
-         updatehashkey(movelist[i]);
+         domove(movelist[i],color);
 
          /* do the ETC lookup:
          with reduced depth and changed color */
@@ -1010,19 +2888,14 @@ if yes, we don't have to search */
          	/* if one of the values we find is > beta we quit! */
          	if( (-ETCvalue)>=beta )
          		{
+               Gstats.etccutoffs++;
             	best=movelist[i];
-               /* before we quit: restore all stuff */
-               Gkey=Lkey;
-               Glock=Llock;
-               togglemove(movelist[i]);
+               undomove(movelist[i]);
+               treecutoff(TREEETC,i);
             	return beta;
             	}
             }
-         /* restore the hash key*/
-      	Gkey=Lkey;
-      	Glock=Llock;
-         /* undo move */
-         togglemove(movelist[i]);
+         undomove(movelist[i]);
          }
       }
 
@@ -1030,134 +2903,135 @@ if yes, we don't have to search */
 #endif
    for(i=0;i<n;i++)
    	{
-      togglemove(movelist[i]);
+      domove(movelist[i],color);
 
-		/* inline material count */
-      if(color==BLACK)
-        	{
-         if(capture)
-         	{
-            wm-=recbitcount(movelist[i].wm);
-         	wk-=recbitcount(movelist[i].wk);
-            }
-         bk+=isprom(movelist[i].info);
-         bm-=isprom(movelist[i].info);
-         }
+      /********************recursion********************/
+#ifdef PVS
+      /* the first move is searched with the full window, the others only have
+      	to show that they are not better. if one is, search it again */
+      if(i==0)
+      	value=-negamax(d-10,color^CC,-beta,-alpha, truncationdepth);
       else
-       	{
-         if(capture)
-         	{
-            bm-=recbitcount(movelist[i].bm);
-         	bk-=recbitcount(movelist[i].bk);
-            }
-         wk+=isprom(movelist[i].info);
-         wm-=isprom(movelist[i].info);
+      	{
+         value=alpha+1;
+#ifdef LMR
+         /* a reduced move has to beat alpha twice, the second time with full depth */
+         r=lmrreduction(movelist[i],i,d,capture,truncationdepth);
+         if(r)
+         	value=-negamax(d-10-r,color^CC,-alpha-1,-alpha, truncationdepth);
+#endif
+         if(value>alpha)
+         	value=-negamax(d-10,color^CC,-alpha-1,-alpha, truncationdepth);
+         if(value>alpha && value<beta)
+         	value=-negamax(d-10,color^CC,-beta,-alpha, truncationdepth);
          }
-		/* end material count */
-
-      /*countmaterial();*/
-      realdepth++;
-#ifdef REPCHECK
-      Ghistory[realdepth+HISTORYOFFSET]=p;
+#else
+      value=-negamax(d-10,color^CC,-beta,-alpha, truncationdepth);
 #endif
-		/*update the hash key*/
-      updatehashkey(movelist[i]);
-
-      /********************recursion********************/
-      value=-negamax(d-10,color^CC,-beta,-alpha, &Lkiller,truncationdepth);
       /*************************************************/
-      realdepth--;
-      togglemove(movelist[i]);
-      /* restore the hash key*/
-      Gkey=Lkey;
-      Glock=Llock;
-      /* restore the old material balance */
-      bm=l_bm;bk=l_bk;wm=l_wm;wk=l_wk;
+      undomove(movelist[i]);
 
       if(value>=beta)
       	{
+         Gstats.failhighs++;
+         if(i==0) Gstats.failhighsfirst++;
          alpha=value;
          best=movelist[i];
+         treecutoff(TREEBETA,i);
+         if(!capture)
+         	{
+#ifdef MOKILLER
+            storekiller(best,color);
+#endif
+#ifdef MOHISTORY
+            historybonus(best,color,d);
+#endif
+#ifdef MOCOUNTER
+            if(counter!=NULL) *counter=(color==BLACK) ? (best.bm|best.bk) : (best.wm|best.wk);
+#endif
+            }
          break;
          }
-      if(value>alpha) {alpha=value;best=movelist[i];}
+      if(value>alpha) {alpha=value;best=movelist[i];treecutoff(TREEMOVES,i);}
+#ifdef SMP
+      /* young brothers wait: the first move has been searched, the rest of
+      	the movelist can be searched together with idle helper threads */
+      if(i==0 && n>1 && Gengine->smpmode==SMPYBWC && d>=SPLITDEPTH && Gengine->smpidle>0)
+      	{
+         if(split(movelist,n,color,d,&alpha,beta,&best,capture,truncationdepth))
+         	break;
+         }
+#endif
       }
+#ifdef SMP
+   /* don't store results of an aborted search */
+   if(Gsplit!=NULL && splitaborted()) return 0;
+#endif
 	/* save the position in the hashtable */
    hashstore(alpha,Lalpha,Lbeta,d,best,color);
-   /* set the killer move */
-#ifdef MOKILLER
-   if(color==BLACK)
-   	*protokiller=best.bm|best.bk;
-   else
-   	*protokiller=best.wm|best.wk;
-#endif
    return alpha;
    }
 
 
+static INLINE int32 hashcheck(struct hashentry *h)
+	{
+   /* the threads share the hashtables without a lock, so a thread can read an
+   	entry while another one writes it. the lock is stored xor the rest of the
+      entry: an entry which is torn between two positions matches neither */
+   return h->best^((int32)(int16)h->value|((int32)h->info<<16));
+   }
+
 void hashstore(int value, int alpha, int beta, int depth, struct move best,int color)
 	{
    /* write the record anyway where the index is*/
    int32 index,minindex;
-   int mindepth=1000,iter=0;
-   int from,to;
+   int mindepth=1000,iter=0,olddepth;
+   struct hashentry h,old;
 
    if(depth<0) return;
-   hashstores++;
+   /* a stopped search returns 0 from its children: its values are wrong, and
+   	the hashtables are kept for the next search */
+   if(atomicget(Gstop)) return;
+   if(depth>DEPTH) depth=DEPTH;
 
-   /* update history table */
+   /* build the entry first and write it in one go */
+   h.info=(int16)((depth&DEPTH)|(Ggeneration<<10));
    if(color==BLACK)
    	{
-      from=(best.bm|best.bk)&(p.bm|p.bk);    /* bit set on square from */
-      to=  (best.bm|best.bk)&(~(p.bm|p.bk));
-      from=lastbit(from);
-      to=lastbit(to);
-      if(from<32)
-      	history[from][to]++;
-		}
-   else
-   	{
-      from=(best.wm|best.wk)&(p.wm|p.wk);    /* bit set on square from */
-      to=  (best.wm|best.wk)&(~(p.wm|p.wk));
-      from=lastbit(from);
-      to=lastbit(to);
-      if(from<32)
-      	history[from][to]++;
+      h.best=best.bm|best.bk;
+      h.info|=HASHBLACK;
       }
+   else
+   	h.best=best.wm|best.wk;
+   h.value=(sint16)valuetohash(value);
+   /* determine valuetype */
+   if(value>=beta) h.info|=LOWER;
+   else if(value>alpha) h.info|=EXACT;
+   else h.info|=UPPER;
+   h.lock=Glock^hashcheck(&h);
 
    if(realdepth < DEEPLEVEL)
    	{
-      /* its in the "deep" hashtable: take care not to overwrite other entries */
+      /* its in the "deep" hashtable: take care not to overwrite other entries.
+      	entries of an earlier search count as depth -1 and are replaced first */
       index=Gkey&HASHMASKDEEP;
       minindex=index;
       while(iter<HASHITER)
       	{
-         if(deep[index].lock==Glock || deep[index].lock==0)
+         old=deep[index];
+         if((old.lock^hashcheck(&old))==Glock || old.lock==0)
             /* found an index where we can write the entry */
       		{
-      		deep[index].lock=Glock;
-      		deep[index].info=(int16) (depth&DEPTH);
-            if(color==BLACK)
-            	{
-               deep[index].best=best.bm|best.bk;
-               deep[index].info|=HASHBLACK;
-            	}
-            else
-            	deep[index].best=best.wm|best.wk;
-
-         	deep[index].value=(sint16)value;
-            /* determine valuetype */
-            if(value>=beta) {deep[index].info|=LOWER;return;}
-   			if(value>alpha) {deep[index].info|=EXACT;return;}
-      		deep[index].info|=UPPER;
+            deep[index]=h;
             return;
             }
          else
          	{
-            if( hashdepth(deep[index].info) < mindepth)
+            olddepth=hashgeneration(old.info)==Ggeneration ? hashdepth(old.info) : -1;
+            if( olddepth < mindepth)
             	{
                minindex=index;
-               mindepth=hashdepth(deep[index].info);
+               mindepth=olddepth;
                }
             }
          iter++;
@@ -1168,44 +3042,16 @@ void hashstore(int value, int alpha, int beta, int depth, struct move best,int c
          entries and all were occupied. in this case, we write the entry
          to minindex */
       if(mindepth>(depth)) return;
-  		deep[minindex].lock=Glock;
-  		deep[minindex].info=(int16) (depth);
-      if(color==BLACK)
-        	deep[minindex].best=best.bm|best.bk;
-      else
-        	deep[minindex].best=best.wm|best.wk;
-  		deep[minindex].info|=(int16)((color>>1)<<13);
-     	deep[minindex].value=value;
-      /* determine valuetype */
-      if(value>=beta) {deep[minindex].info|=LOWER;return;}
-    	if(value>alpha) {deep[minindex].info|=EXACT;return;}
-      deep[minindex].info|=UPPER;
+      deep[minindex]=h;
       return;
-      /* and return */
       }
    else
    	{
    	index=Gkey&HASHMASKSHALLOW;
-      if( hashdepth(shallow[index].info) <= depth )
-      /* replace the old entry if the new depth is larger */
-         {
-      	shallow[index].lock=Glock;
-   		shallow[index].info=(int16)depth;
-      	shallow[index].value=(sint16)value;
-      	if(color==BLACK)
-      		{
-            shallow[index].best=best.bm|best.bk;
-            shallow[index].info|=HASHBLACK;
-         	}
-      	else
-        		shallow[index].best=best.wm|best.wk;
-
-         /* determine valuetype */
-
-	   	if(value>=beta) {shallow[index].info|=LOWER;return;}
-   		if(value>alpha) {shallow[index].info|=EXACT;return;}
-      	shallow[index].info|=UPPER;
-   		}
+      old=shallow[index];
+      if( hashdepth(old.info) <= depth || hashgeneration(old.info)!=Ggeneration )
+      /* replace the old entry if the new depth is larger or if it is from an earlier search */
+      	shallow[index]=h;
       }
    return;
    }
@@ -1213,45 +3059,48 @@ void hashstore(int value, int alpha, int beta, int depth, struct move best,int c
 int hashlookup(int *value, int *alpha, int *beta, int depth, int32 *forcefirst, int color)
 	{
    int32 index;
-   int iter=0;
-
-   hashsearch++;
+   int iter=0,hashvalue;
+   struct hashentry h;
 
    if(realdepth<DEEPLEVEL)
       /* a position in the "deep" hashtable - it's important to find it since */
       /* the effect is larger here! */
    	{
-      hashhit++;
+      Gstats.deepprobes++;
       index=Gkey&HASHMASKDEEP;
       while(iter<HASHITER)
       	{
-      	if(deep[index].lock==Glock && (hashcolor(deep[index].info)>>13)==(color>>1))
+         /* work on a copy: the entry may change under us */
+         h=deep[index];
+      	if((h.lock^hashcheck(&h))==Glock && (hashcolor(h.info)>>13)==(color>>1))
       		{
             /* we have found the position */
-         	hashhit++;
+         	Gstats.deephits++;
          	/* move ordering */
-      		*forcefirst=deep[index].best;
+      		*forcefirst=h.best;
          	/* use value if depth in hashtable >= current depth)*/
-         	if(hashdepth(deep[index].info)>=depth)
+         	if(hashdepth(h.info)>=depth)
          		{
             	/* if it's an exact value we can use it */
-            	if(hashvaluetype(deep[index].info) == EXACT)
+               hashvalue=valuefromhash(h.value);
+            	if(hashvaluetype(h.info) == EXACT)
             		{
-               	*value=deep[index].value;
+               	*value=hashvalue;
+            		Gstats.deepcutoffs++;
             		return 1;
                	}
             	/* lower bound */
-            	if(hashvaluetype(deep[index].info) == LOWER)
+            	if(hashvaluetype(h.info) == LOWER)
             		{
-               	if(deep[index].value>=(*beta)) {*value=deep[index].value;return 1;}
-               	if(deep[index].value>(*alpha)) {*alpha=deep[index].value;}
+               	if(hashvalue>=(*beta)) {*value=hashvalue;Gstats.deepcutoffs++;return 1;}
+               	if(hashvalue>(*alpha)) {*alpha=hashvalue;}
             		return 0;
                	}
             	/* upper bound */
-            	if(hashvaluetype(deep[index].info) == UPPER)
+            	if(hashvaluetype(h.info) == UPPER)
             		{
-               	if(deep[index].value<=*alpha) {*value=deep[index].value;return 1;}
-               	if(deep[index].value<*beta)   {*beta=deep[index].value;}
+               	if(hashvalue<=*alpha) {*value=hashvalue;Gstats.deepcutoffs++;return 1;}
+               	if(hashvalue<*beta)   {*beta=hashvalue;}
             		return 0;
                	}
                }
@@ -1265,31 +3114,35 @@ int hashlookup(int *value, int *alpha, int *beta, int depth, int32 *forcefirst,
    /* use shallow hashtable */
    else
    	{
+      Gstats.shallowprobes++;
       index=Gkey&HASHMASKSHALLOW;
-   	if(shallow[index].lock==Glock && (hashcolor(shallow[index].info)>>13)==(color>>1))
+      h=shallow[index];
+   	if((h.lock^hashcheck(&h))==Glock && (hashcolor(h.info)>>13)==(color>>1))
    		{
-      	hashhit++;
+      	Gstats.shallowhits++;
       	/*found the right entry!*/
-      	*forcefirst=shallow[index].best;
-      	if(hashdepth(shallow[index].info)>=depth)
+      	*forcefirst=h.best;
+      	if(hashdepth(h.info)>=depth)
          	{
-            if(hashvaluetype(shallow[index].info) == EXACT)
+            hashvalue=valuefromhash(h.value);
+            if(hashvaluetype(h.info) == EXACT)
             	{
-               *value=shallow[index].value;
+               *value=hashvalue;
+            	Gstats.shallowcutoffs++;
             	return 1;
                }
             /* lower bound */
-            if(hashvaluetype(shallow[index].info) == LOWER)
+            if(hashvaluetype(h.info) == LOWER)
             	{
-               if(shallow[index].value>=*beta) {*value=shallow[index].value;return 1;}
-               if(shallow[index].value>*alpha) {*alpha=shallow[index].value;}
+               if(hashvalue>=*beta) {*value=hashvalue;Gstats.shallowcutoffs++;return 1;}
+               if(hashvalue>*alpha) {*alpha=hashvalue;}
             	return 0;
                }
             /* upper bound */
-            if(hashvaluetype(shallow[index].info) == UPPER)
+            if(hashvaluetype(h.info) == UPPER)
             	{
-               if(shallow[index].value<=*alpha) {*value=shallow[index].value;return 1;}
-               if(shallow[index].value<*beta)   {*beta=shallow[index].value;}
+               if(hashvalue<=*alpha) {*value=hashvalue;Gstats.shallowcutoffs++;return 1;}
+               if(hashvalue<*beta)   {*beta=hashvalue;}
             	return 0;
                }
             }
@@ -1298,37 +3151,62 @@ int hashlookup(int *value, int *alpha, int *beta, int depth, int32 *forcefirst,
    return 0;
    }
 
-void getpv(char *str,int color)
+int getpvmoves(struct move pv[], int max, int color)
 	{
-   /* retrieve the principal variation from the hashtable */
+   /* retrieve the principal variation from the hashtable, at most max moves.
+   	returns their number. its probes are no part of the search and don't go
+      into the statistics */
    struct move movelist[MAXMOVES];
    int32 forcefirst;
+   int32 Lkey=Gkey,Llock=Glock;
    int dummy=0;
    int i,n;
-   char Lstr[256];
    struct pos Lp;
+   struct cakestats Lstats;
 
    Lp=p;
+   Lstats=Gstats;
    absolutehashkey();
-   strcpy(str,"");
-   for(i=0;i<DEEPLEVEL;i++)
+   if(max>DEEPLEVEL) max=DEEPLEVEL;
+   for(i=0;i<max;i++)
    	{
       hashlookup(&dummy,&dummy,&dummy,0, &forcefirst,color);
       n=makecapturelist(movelist,color,forcefirst);
       if(!n)
-      	n=makemovelist(movelist,color,forcefirst,0);
-      if(!n) {p=Lp;return;}
+      	n=makemovelist(movelist,color,forcefirst,NULL,0);
+      if(!n) break;
+      pv[i]=movelist[0];
+      togglemove(movelist[0]);
+      absolutehashkey();
+      color=color^CC;
+      }
+   p=Lp;
+   Gkey=Lkey;
+   Glock=Llock;
+   Gstats=Lstats;
+   return i;
+   }
 
-      movetonotation(p,movelist[0],Lstr,color);
+void getpv(char *str,int color)
+	{
+   /* the principal variation from the hashtable in notation */
+   struct move pv[DEEPLEVEL];
+   int i,n;
+   char Lstr[256];
+   struct pos Lp;
 
+   Lp=p;
+   n=getpvmoves(pv,DEEPLEVEL,color);
+   strcpy(str,"");
+   for(i=0;i<n;i++)
+   	{
+      movetonotation(p,pv[i],Lstr,color);
       strcat(str,Lstr);
       strcat(str," ");
-      togglemove(movelist[0]);
-      absolutehashkey();
+      togglemove(pv[i]);
       color=color^CC;
       }
    p=Lp;
-   return;
    }
 
       /* test because of crash
@@ -1438,8 +3316,8 @@ int evaluation(int color, int alpha, int beta)
    /************************* material **************************/
    v1=100*bm+130*bk;
    v2=100*wm+130*wk;
-   if(v1==0) return(color==BLACK?(-5000+realdepth):5000-realdepth);
-   if(v2==0) return(color==BLACK?(5000-realdepth):-5000+realdepth);
+   if(v1==0) return(color==BLACK?(-MATE+realdepth):MATE-realdepth);
+   if(v2==0) return(color==BLACK?(MATE-realdepth):-MATE+realdepth);
 
 #ifdef USEDB
    allstones=bm+bk+wm+wk;
@@ -1,14 +1,60 @@
 /* cake++.h */
 
 /* prototypes for all functions in cake++ */
+struct cakeengine;
+struct cakeengine *cake_createengine(int logging);
+void cake_destroyengine(struct cakeengine *e);
+int cake_enginegetmove(struct cakeengine *e, struct pos *position,int color, int how,double maxtime, int depthtosearch,int32 maxnodes, char str[255], int *playnow, int logging,int reset);
+/* one engine per game: engines are independent and can search on different threads at once */
 int initcake(int logging);
 int exitcake(void);
 int cake_getmove(struct pos *position,int color, int how,double maxtime, int depthtosearch,int32 maxnodes, char str[255], int *playnow, int logging,int reset);
 /* returns the value of the position */
+extern unsigned int cake_nodes;
+/* nodes of all threads in the last cake_getmove */
+void cake_stop(struct cakeengine *e);
+/* stop the search of the engine as soon as possible, from any thread. it returns the last complete iteration */
+int cake_setnodestride(struct cakeengine *e, int nodes);
+/* look at the clock and the playnow flag every nodes nodes, rounded to a power of 2. returns the stride used */
+long long nanotime(void);
+int cake_setthreads(struct cakeengine *e, int n);
+/* number of threads for cake_getmove, returns the number actually used */
+int cake_setsmpmode(struct cakeengine *e, int mode);
+/* SMPLAZY or SMPYBWC */
+int cake_setmultipv(struct cakeengine *e, int k);
+/* number of best moves which get an exact value, returns the number used */
+int cake_setbook(struct cakeengine *e, int on);
+/* use the opening book, on by default */
+int cake_setinfo(struct cakeengine *e, void (*callback)(struct cakeinfo *info, void *data), void *data);
+/* callback(info,data) gets the progress of every search, NULL turns it off */
+int cake_readlog(struct cakelogrecord records[], int max);
+/* take up to max records out of the log, which searches with logging&1 write. returns their number */
+long cake_logdropped(void);
+/* number of records lost because nobody read the log in time */
+int cake_logtofile(char *filename);
+/* a thread writes the log to filename as text, NULL stops it. logging&1 at engine creation starts it for cakelog.txt */
+int cake_settreefile(struct cakeengine *e, char *filename);
+/* with TREELOG: record every node of the engine's searches in filename for the tree tool, NULL stops. returns 0 if it can't */
+int cake_getlines(struct cakeengine *e, struct cakeline lines[], int max);
+/* the lines of the last search, best first. returns how many there are */
+int cake_getstats(struct cakeengine *e, struct cakestats *stats);
+/* statistics of the last search */
+int cake_setstatsfile(struct cakeengine *e, char *filename);
+/* append the statistics of every search to filename as a line of json, NULL turns it off */
+int cake_ponder(struct cakeengine *e, struct pos *position, int color, int how, double maxtime, int depthtosearch, int32 maxnodes, int logging, struct pos *expected);
+/* after cake_enginegetmove: search the expected reply in the background. returns 0 if there is none */
+int cake_ponderhit(struct cakeengine *e, struct pos *position, char str[255]);
+/* the expected reply was played: finish the ponder search, returns like cake_enginegetmove */
+void cake_pondermiss(struct cakeengine *e);
+/* another move was played: abort the ponder search */
+int cake_analyze(struct cakejob jobs[], int n, int threads);
+/* search n independent positions on threads engines of their own. returns the number searched */
+double walltime(void);
+unsigned int searchnodes(void);
 void countmaterial(void);
 void initboard(void);
 int firstnegamax(int d, int color, int alpha, int beta, struct move *best);
-int negamax(int depth, int color, int alpha, int beta, int32 *bestproto, int truncationdepth);
+int negamax(int depth, int color, int alpha, int beta, int truncationdepth);
 int evaluation(int color, int alpha, int beta);
 int fineevaluation(int color);
 int bitcount(int32 n);
@@ -20,6 +66,7 @@ void hashstore(int value, int alpha, int beta, int depth, struct move best, int
 int hashlookup(int *value, int *alpha, int *beta, int depth, int32 *best, int color);
 void movetonotation(struct pos position,struct move m, char *str, int color);
 void getpv(char *str, int color);
+int getpvmoves(struct move pv[], int max, int color);
 int testcapture(int color);
 int dbwineval(int color);
 int dblosseval(int color);
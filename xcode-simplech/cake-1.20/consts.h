@@ -38,6 +38,11 @@
 #define FREE 16
 #define CC 3
 #define MAXMOVES 28
+
+/* values: a side without moves has lost, MATE less the plies from the root.
+	values beyond MATEVALUE are such wins and losses */
+#define MATE 5000
+#define MATEVALUE 4500
 /* number of moves in the movelist - saw crashes with 24!*/
 
 
@@ -54,7 +59,8 @@
 #define isextend(a) ((a&ISEXTEND)>>18)
 
 /* masks for hashentry.info */
-#define DEPTH	0x00001FFF
+#define DEPTH	0x000003FF
+#define GENERATION 0x00001C00
 #define COLOR 0x00002000
 #define VALUETYPE 0x0000C000
 #define LOWER 0x00004000
@@ -64,6 +70,8 @@
 #define HASHWHITE 0x00000000
 
 #define hashdepth(x) (x&DEPTH)
+#define hashgeneration(x) ((x&GENERATION)>>10)
+#define MAXGENERATION 8
 #define hashcolor(x) (x&COLOR)
 #define hashvaluetype(x) (x&VALUETYPE)
 
@@ -167,6 +175,10 @@
 #define rb1(x) ((x&RB1)<<4)
 #define rb2(x) ((x&RB2)<<3)
 
+/* smp modes for cake_setsmpmode() */
+#define SMPLAZY 0
+#define SMPYBWC 1
+
 /* database values */
 #define DRAW 0
 #define WIN 1
@@ -21,6 +21,12 @@
 #endif
 
 #define int32 unsigned long
+/* as in structs.h, which db.c can't include because of its own struct pos */
+#ifdef SYS_WINDOWS
+#define THREADLOCAL __declspec(thread)
+#else
+#define THREADLOCAL __thread
+#endif
 struct pos
 	{
    int32 bm;
@@ -249,7 +255,7 @@ int Div[7] = { 0, 1, 3, 9, 27, 81, 243 };
 
 DBENTRYPTR DBTable[DBTABLESIZE];
 int DBFile;
-extern int logging; /* global from cake++.c*/
+extern THREADLOCAL int logging; /* global from cake++.c*/
 FILE *fp;
 /*
  * Table to map between DB board representation and Chinook's
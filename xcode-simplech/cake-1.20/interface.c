@@ -56,7 +56,7 @@ int islegal(struct pos *position,int color, int from, int to)
    struct move movelist[MAXMOVES];
    int i,n,Lfrom,Lto;
    char c,Lstr[256];
-   extern struct pos p; /* from cakepp.c */
+   extern THREADLOCAL struct pos p; /* from cakepp.c */
 
 
    /*printboard(*position);*/
@@ -64,7 +64,7 @@ int islegal(struct pos *position,int color, int from, int to)
    p=*position;
    n=makecapturelist(movelist,color,0);
    if(!n)
-   	n=makemovelist(movelist,color,0,0);
+   	n=makemovelist(movelist,color,0,NULL,0);
 
    /* for all moves: convert move to notation and compare */
    for(i=0;i<n;i++)
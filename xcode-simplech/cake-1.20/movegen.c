@@ -29,15 +29,18 @@
 #define KCV 2
 #define PV 2
 
+#include <stdio.h>
 #include "structs.h"
 #include "consts.h"
 #include "movegen.h"
 #include "cakepp.h"
 #include "switches.h"
 
-/* values used for dynamic move ordering */
-#define HASHMOVE 1000
-#define KILLER 100
+/* values used for dynamic move ordering. the hash move is not among them:
+	it always gets the largest value, see makemovelist() */
+#define KILLER 900  /* the first killer of the ply... */
+#define KILLER2 800 /* ...and the second one */
+#define COUNTERMOVE 700
 /* values used for static move ordering */
 #define C4 0x00042000   /*innermost squares */
 #define C3 0x00624600   /* center squares */
@@ -53,15 +56,16 @@
 #define KINGC1VAL -10
 #define CAPT 50
 #define HISTORY 300
-#define MINHASH 100
-extern struct pos p;
+#define MINHISTORY 100
+extern THREADLOCAL struct pos p;
 
-int makemovelist(struct move movelist[MAXMOVES],int color, int32 hashmove, int32 killer)
+int makemovelist(struct move movelist[MAXMOVES],int color, int32 hashmove, int32 *killers, int32 countermove)
 	{
    int32 i,n=0,free;
    int32 m,tmp;
    struct move tmpmove;
    int swap;
+   int first=-1;  /* index of the hash move */
 /*
        WHITE
    	28  29  30  31
@@ -284,7 +288,7 @@ int makemovelist(struct move movelist[MAXMOVES],int color, int32 hashmove, int32
          		{
             	if((movelist[i].bm|movelist[i].bk) == hashmove)
             		{
-               	movelist[i].info+=HASHMOVE;
+               	first=i;
 						break;
                	}
             	}
@@ -295,18 +299,31 @@ int makemovelist(struct move movelist[MAXMOVES],int color, int32 hashmove, int32
       /* sort moves: according to movelist[n].info&MOVEVAL */
       if(n>1)
       	{
-         /* give the forcefirst-move a high eval */
-         if(killer)
+         /* the killers of this ply come right after the hash move */
+         if(killers!=NULL && killers[0])
+         	{
+            for(i=0;i<n;i++)
+         		{
+            	if((movelist[i].bm|movelist[i].bk) == killers[0])
+            		movelist[i].info+=KILLER;
+            	else if((movelist[i].bm|movelist[i].bk) == killers[1])
+            		movelist[i].info+=KILLER2;
+            	}
+            }
+#ifdef MOCOUNTER
+         /* and then the move which refuted the opponent's move last time */
+         if(countermove)
          	{
             for(i=0;i<n;i++)
          		{
-            	if((movelist[i].bm|movelist[i].bk) == killer)
+            	if((movelist[i].bm|movelist[i].bk) == countermove)
             		{
-               	movelist[i].info+=KILLER;
-						break;
-               	}
+                  if(moveval(movelist[i].info)<KILLER2) movelist[i].info+=COUNTERMOVE;
+                  break;
+                  }
             	}
             }
+#endif
          }
 #endif
 
@@ -314,6 +331,9 @@ int makemovelist(struct move movelist[MAXMOVES],int color, int32 hashmove, int32
       if(n>1)
 			{
          blackorderevaluation(movelist,n);
+         /* killers and the static terms together can be worth more than a
+         	bonus: the hash move simply gets the largest value */
+         if(first>=0) movelist[first].info|=MOVEVAL;
 #ifdef DOORDERING
   /* now do the ordering */
          swap=1;
@@ -551,7 +571,7 @@ int makemovelist(struct move movelist[MAXMOVES],int color, int32 hashmove, int32
          		{
             	if((movelist[i].wm|movelist[i].wk) == hashmove)
             		{
-               	movelist[i].info+=HASHMOVE;
+               	first=i;
                	break;
                	}
             	}
@@ -562,24 +582,38 @@ int makemovelist(struct move movelist[MAXMOVES],int color, int32 hashmove, int32
       /* sort moves, promotions first */
       if(n>1)
       	{
-         /* give the forcefirst-move a high eval */
-         if(killer)
+         /* the killers of this ply come right after the hash move */
+         if(killers!=NULL && killers[0])
+         	{
+            for(i=0;i<n;i++)
+         		{
+            	if((movelist[i].wm|movelist[i].wk) == killers[0])
+            		movelist[i].info+=KILLER;
+            	else if((movelist[i].wm|movelist[i].wk) == killers[1])
+            		movelist[i].info+=KILLER2;
+            	}
+            }
+#ifdef MOCOUNTER
+         /* and then the move which refuted the opponent's move last time */
+         if(countermove)
          	{
             for(i=0;i<n;i++)
          		{
-            	if((movelist[i].wm|movelist[i].wk) == killer)
+            	if((movelist[i].wm|movelist[i].wk) == countermove)
             		{
-               	movelist[i].info+=KILLER;
-               	break;
-               	}
+                  if(moveval(movelist[i].info)<KILLER2) movelist[i].info+=COUNTERMOVE;
+                  break;
+                  }
             	}
             }
+#endif
          }
 #endif
 
   		if(n>1) /* in this case we have to order the list */
       	{
          whiteorderevaluation(movelist,n);
+         if(first>=0) movelist[first].info|=MOVEVAL;
 #ifdef DOORDERING
          /* now do the ordering */
          /* bubble sort */
@@ -613,8 +647,8 @@ void blackorderevaluation(struct move ml[MAXMOVES],int n)
    int32 black;
    int i;
 
-   extern int32 history[32][32]; /*has entries for how often a move was good */
-   extern int hashstores;        /* is the number of entries in history list */
+   extern THREADLOCAL int32 history[32][32]; /*has entries for how often a move was good */
+   extern THREADLOCAL int32 historytotal;    /* is the sum of all entries in history list */
 	for(i=0;i<n;i++)
 		{
    	eval=0;
@@ -625,7 +659,7 @@ void blackorderevaluation(struct move ml[MAXMOVES],int n)
       to=(ml[i].bm|ml[i].bk)&(~black);
 #ifdef MOHISTORY
       /* history...*/
-      if(hashstores>MINHASH) eval+=( (HISTORY*history[lastbit(from)][lastbit(to)]) / (hashstores));
+      if(historytotal>MINHISTORY) eval+=( (HISTORY*history[lastbit(from)][lastbit(to)]) / (historytotal));
 #endif
 
 #ifdef MOSTATIC
@@ -715,8 +749,8 @@ void whiteorderevaluation(struct move ml[MAXMOVES],int n)
    int32 from,to;
    int32 white;
    int i;
-   extern int32 history[32][32];
-   extern int hashstores;
+   extern THREADLOCAL int32 history[32][32];
+   extern THREADLOCAL int32 historytotal;
 
 	for(i=0;i<n;i++)
 		{
@@ -726,8 +760,8 @@ void whiteorderevaluation(struct move ml[MAXMOVES],int n)
       to=((ml[i].wm)|(ml[i].wk))&(~white);
 #ifdef MOHISTORY
       /* history...*/
-      if(hashstores>MINHASH)
-      eval+=( (HISTORY*history[lastbit(from)][lastbit(to)]) / (hashstores));
+      if(historytotal>MINHISTORY)
+      eval+=( (HISTORY*history[lastbit(from)][lastbit(to)]) / (historytotal));
 #endif
 
 #ifdef MOSTATIC
@@ -1,6 +1,6 @@
 /* movegen.h: function prototypes of movegen.c */
 
-int makemovelist(struct move movelist[MAXMOVES],int color, int32 hashmove, int32 killer);
+int makemovelist(struct move movelist[MAXMOVES],int color, int32 hashmove, int32 *killers, int32 countermove);
 void blackorderevaluation(struct move ml[MAXMOVES],int n);
 void whiteorderevaluation(struct move ml[MAXMOVES],int n);
 
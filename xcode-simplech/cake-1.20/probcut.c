@@ -0,0 +1,94 @@
+/* probcut.c: fits the probcut parameters of cake++
+
+	compile cake++ with PROBCUTLOG defined and let it search some positions.
+   it writes lines "depth shallowvalue deepvalue" to probcut.txt, one for
+   every sampled probcut node. this program fits
+
+   	deep = PROBCUTA*shallow + PROBCUTB + error
+
+   by least squares and prints the #defines for switches.h, with PROBCUTSIGMA
+   the standard deviation of the error. the fit is also shown for every depth,
+   to see whether one line is good enough for all of them.
+
+   usage: probcut [file]    (default probcut.txt) */
+
+#include <stdio.h>
+#include <math.h>
+
+#define MAXFITDEPTH 1000
+
+struct fit
+	{
+   int n;
+   double sx,sy,sxx,sxy,syy;
+   };
+
+static void addsample(struct fit *f, double x, double y)
+	{
+   f->n++;
+   f->sx+=x;
+   f->sy+=y;
+   f->sxx+=x*x;
+   f->sxy+=x*y;
+   f->syy+=y*y;
+   }
+
+static int solve(struct fit *f, double *a, double *b, double *sigma)
+	{
+   /* least squares line through the samples of f, returns 0 if there is none */
+   double n=f->n,det,sse;
+
+   if(f->n<3) return 0;
+   det=n*f->sxx-f->sx*f->sx;
+   if(det==0) return 0;
+   *a=(n*f->sxy-f->sx*f->sy)/det;
+   *b=(f->sy-(*a)*f->sx)/n;
+   /* sum of the squared errors */
+   sse=f->syy-2*(*a)*f->sxy-2*(*b)*f->sy+(*a)*(*a)*f->sxx+2*(*a)*(*b)*f->sx+n*(*b)*(*b);
+   if(sse<0) sse=0;
+   *sigma=sqrt(sse/(n-2));
+   return 1;
+   }
+
+int main(int argc, char *argv[])
+	{
+   static struct fit depthfit[MAXFITDEPTH];
+   struct fit all={0};
+   char *filename="probcut.txt";
+   FILE *fp;
+   int d,shallow,deep;
+   double a,b,sigma;
+
+   if(argc>1) filename=argv[1];
+   fp=fopen(filename,"r");
+   if(fp==NULL)
+   	{
+      printf("can't open %s\n",filename);
+      return 1;
+      }
+   while(fscanf(fp,"%i %i %i",&d,&shallow,&deep)==3)
+   	{
+      addsample(&all,shallow,deep);
+      if(d>=0 && d<MAXFITDEPTH)
+      	addsample(&depthfit[d],shallow,deep);
+      }
+   fclose(fp);
+
+   if(!solve(&all,&a,&b,&sigma))
+   	{
+      printf("not enough samples in %s\n",filename);
+      return 1;
+      }
+   printf("depth  samples       a        b    sigma\n");
+   for(d=0;d<MAXFITDEPTH;d++)
+   	{
+      double da,db,ds;
+      if(solve(&depthfit[d],&da,&db,&ds))
+      	printf("%5i %8i %7.3f %8.2f %8.2f\n",d,depthfit[d].n,da,db,ds);
+      }
+   printf("  all %8i %7.3f %8.2f %8.2f\n\n",all.n,a,b,sigma);
+   printf("#define PROBCUTA %.3f\n",a);
+   printf("#define PROBCUTB %.2f\n",b);
+   printf("#define PROBCUTSIGMA %.2f\n",sigma);
+   return 0;
+   }
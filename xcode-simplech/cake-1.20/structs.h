@@ -5,9 +5,41 @@
 #define int16 unsigned short
 #define int8  unsigned char
 #define sint32 signed int
+#define int64 unsigned long long
 #define sint16 signed short
 #define sint8  signed char
 
+/* storage class for the search state which every search thread owns privately */
+#ifdef SYS_WINDOWS
+#define THREADLOCAL __declspec(thread)
+#else
+#define THREADLOCAL __thread
+#endif
+
+/* for the small functions of the innermost search loop */
+#ifdef SYS_WINDOWS
+#define INLINE __forceinline
+#else
+#define INLINE inline __attribute__((always_inline))
+#endif
+
+/* flags which one thread sets and others read while they search */
+#ifdef SYS_WINDOWS
+#define atomicget(x) (*(x))         /* volatile reads are acquires with msvc */
+#define atomicset(x,v) InterlockedExchange((x),(v))
+#define atomicget64(x) InterlockedCompareExchange64((x),0,0)
+#define atomicset64(x,v) InterlockedExchange64((x),(v))
+#define atomiccas(x,old,new) (InterlockedCompareExchange((x),(new),(old))==(old))
+#define atomicadd(x,v) InterlockedExchangeAdd((x),(v))
+#else
+#define atomicget(x) __atomic_load_n((x),__ATOMIC_ACQUIRE)
+#define atomicset(x,v) __atomic_store_n((x),(v),__ATOMIC_RELEASE)
+#define atomicget64(x) __atomic_load_n((x),__ATOMIC_ACQUIRE)
+#define atomicset64(x,v) __atomic_store_n((x),(v),__ATOMIC_RELEASE)
+#define atomiccas(x,old,new) __sync_bool_compare_and_swap((x),(old),(new))
+#define atomicadd(x,v) __atomic_fetch_add((x),(v),__ATOMIC_RELAXED)
+#endif
+
 struct move
 	{
    int32 bm;
@@ -25,6 +57,122 @@ struct pos
    int32 wk;
    };
 
+struct cakeline    /* one line of a multi-pv search */
+	{
+   struct pos position;  /* the position after the move */
+   int value;
+   char pv[256];         /* the move and the principal variation after it */
+   };
+
+#define MAXITERATIONS 50
+
+struct cakestats   /* what one search did, see cake_getstats() */
+	{
+   int depth;                    /* depth of the last complete iteration */
+   int seldepth;                 /* deepest ply reached */
+   int value;
+   unsigned int nodes;           /* of all threads */
+   double time;                  /* seconds */
+   double nps;
+   int iterations;               /* number of complete iterations */
+   unsigned int iternodes[MAXITERATIONS]; /* nodes of each of them */
+   unsigned int deepprobes,deephits,deepcutoffs;          /* hashtable for realdepth<DEEPLEVEL */
+   unsigned int shallowprobes,shallowhits,shallowcutoffs; /* and for the rest */
+   unsigned int etccutoffs;
+   unsigned int failhighs;       /* beta cutoffs in negamax... */
+   unsigned int failhighsfirst;  /* ...and how many of them by the first move */
+   unsigned int dbprobes,dbhits;
+   unsigned int extensions,truncations;
+   unsigned int probcuts;        /* nodes pruned by probcut */
+   int stopped;                  /* the search was stopped... */
+   double stoplatency;           /* ...and took this long from the request to return */
+   };
+
+#define MAXPV 10
+
+struct cakeinfo    /* progress of a search, see cake_setinfo() */
+	{
+   int depth;                    /* of the iteration, in plies */
+   int seldepth;                 /* deepest ply reached */
+   int value;
+   int bound;                    /* EXACT, or LOWER / UPPER if the aspiration window failed high / low */
+   unsigned int nodes;           /* of all threads */
+   double time;                  /* seconds */
+   double nps;
+   int color;                    /* side to move at the root */
+   int npv;                      /* number of moves in pv... */
+   struct move pv[MAXPV];        /* ...the best move and the expected reply and so on */
+   };
+
+/* kinds of records in the log, see cake_readlog() */
+#define LOGSEARCH 1        /* a search starts in position */
+#define LOGBOOK 2          /* a book move was played, position is the one after it */
+#define LOGINFO 3          /* progress of the search in position, as for cake_setinfo() */
+#define LOGRESULT 4        /* the search in position is done, info has the pv */
+
+struct cakelogrecord
+	{
+   int type;
+   long long ns;                 /* nanotime() when it was written */
+   struct pos position;
+   int color;                    /* side to move in position */
+   int value;
+   unsigned int dbprobes;        /* LOGINFO: database lookups so far */
+   struct cakeinfo info;         /* LOGINFO and LOGRESULT */
+   };
+
+/* the search tree recorder, see cake_settreefile(). the file is a struct treeheader
+	and the records after it, one for every node the main thread has left */
+#define TREEMAGIC 0x45455254  /* "TREE" */
+#define TREENOMOVE 255        /* move of a node where no move mattered */
+
+/* why a node returned */
+#define TREEMOVES 0        /* all moves were searched, move is the best one */
+#define TREEBETA 1         /* move failed high */
+#define TREEHASH 2         /* the hashtable had the value */
+#define TREEETC 3          /* the hashtable had a value for the position after move */
+#define TREEDB 4           /* database draw or win */
+#define TREEPROBCUT 5      /* a shallow search predicted the cutoff */
+#define TREEREPETITION 6
+#define TREEMATE 7         /* no moves, or no window left between the fastest win and loss */
+#define TREELEAF 8         /* evaluation, or negamax handed the node to quiescence */
+
+struct treeheader
+	{
+   int32 magic;
+   int32 recordsize;             /* sizeof(struct treerecord) */
+   int32 size;                   /* there is room for this many records... */
+   int32 n;                      /* ...and this many are written */
+   };
+
+struct treerecord
+	{
+   int32 key,lock;               /* hash key of the node */
+   sint16 alpha,beta;            /* the window it was searched with */
+   sint16 value;                 /* what the search returned */
+   sint16 depth;                 /* remaining depth, 10 per ply. 0 in quiescence */
+   int8 ply;                     /* distance from the root */
+   int8 color;                   /* side to move */
+   int8 cutoff;                  /* TREEMOVES, TREEBETA... */
+   int8 move;                    /* index of the move in the movelist, TREENOMOVE if none */
+   };
+
+struct cakejob     /* one position for cake_analyze() */
+	{
+   struct pos position;  /* in: the position to analyze... */
+   int color;            /* ...and the side to move in it */
+   int how;              /* in: limits as for cake_getmove: 0 time, 1 depth, 2 nodes */
+   double maxtime;
+   int depth;
+   int32 maxnodes;
+   struct pos result;    /* out: the position after the best move */
+   int value;
+   char str[256];        /* out: best move, value and pv as cake_getmove writes them */
+   int npv;              /* out: number of moves in pv... */
+   struct move pv[MAXPV];/* ...the best move, the expected reply and so on */
+   struct cakestats stats;
+   };
+
 struct hashentry
 	{
    int32  lock;
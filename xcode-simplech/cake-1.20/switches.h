@@ -15,13 +15,15 @@
 #undef EVALOFF              /* return 0 in eval */
 #undef EVALMATERIALONLY     /* turn off all positional evaluation */
 #define REPCHECK            /* check for repetitions */
+#define MATEPRUNING         /* no window beyond the fastest possible win or loss */
 #define MOVEORDERING 		 /* turns on all move ordering */
 									 /* if not set: overrules the three switches below ! */
 #define MOSTATIC  				/* use static move ordering */
 #define MOTESTCAPT         /* a very expensive part of static move ordering */
 #define MOHASH          /* use a move from hashtable or killer move */
-#define MOKILLER 				/* use killer if no move from hashtable */
+#define MOKILLER 				/* order two killer moves per ply after the hash move */
 #define MOHISTORY          /* use history table */
+#define MOCOUNTER          /* order the reply to the opponent's last move after the killers */
 #define DOORDERING			/* do the bubble sort: just to test how slow this really is */
 
 #define GRAINSIZE 2         /* with this grain size */
@@ -38,11 +40,40 @@
 #define TABLE16             /* use bitcount with bitsinword[65536] */
 #define ETC						/* use enhanced transposition cutoffs */
 #define ETCDEPTH 20			/* if depth>etcdepth do ETC */
+#define PVS                 /* principal variation search: null window for all but the first move */
+#define LMR                 /* late move reductions, needs PVS */
+#define LMRDEPTH 30         /* only reduce if depth>=lmrdepth */
+#define LMRMOVES 3          /* never reduce the first lmrmoves moves */
+#define LMRVALUE 128        /* only reduce moves with an ordering value below this */
+#define LMRREDUCTION 10     /* by how much */
+#define IID                 /* internal iterative deepening if the hashtable has no move */
+#define IIDDEPTH 40         /* ...at pv nodes with depth>=iiddepth */
+#define IIDDEPTHNULL 80     /* ...and at null window nodes with depth>=iiddepthnull */
+#define IIDREDUCTION 40     /* the move comes from a search this much less deep */
+#define PROBCUT             /* prune if a shallow search predicts a cutoff of the deep one */
+#define PROBCUTDEPTH 80     /* only at nodes with depth>=probcutdepth */
+#define PROBCUTREDUCTION 60 /* the shallow search is this much less deep */
+#define PROBCUTA 1.014      /* deep value = PROBCUTA*shallow value + PROBCUTB + error, */
+#define PROBCUTB 2.32       /* fitted by the probcut tool from the output of PROBCUTLOG */
+#define PROBCUTSIGMA 28.9   /* standard deviation of the error */
+#define PROBCUTT 1.5        /* prune if the shallow value is this many sigmas outside the window */
+#define PROBCUTMAXVALUE 1000 /* no probcut with database or mate values */
+#undef  PROBCUTLOG          /* write shallow and deep values of probcut nodes to probcut.txt */
+#define PROBCUTSAMPLE 0x3F  /* ...for one in PROBCUTSAMPLE+1 of them */
+#undef  TREELOG             /* record the nodes of the search to a file for the tree tool, see cake_settreefile() */
+#define TREELOGSIZE 0x00400000 /* the file has room for this many records, 20 bytes each */
 /* some stuff for search */
 #define MAXDEPTH 99
 #define FINEEVALWINDOW 150
 #define HISTORYOFFSET 10
 #define ASPIRATIONWINDOW 10
+#define NODESTRIDE 1024     /* look at the clock every NODESTRIDE nodes, see cake_setnodestride() */
+#define TIMEHARD 1.0        /* time mode: the search is aborted at TIMEHARD*maxtime */
+#define BRANCHDEFAULT 4.0   /* time mode: growth of an iteration if the last ones were too fast to measure */
+#define BRANCHMIN 1.5       /* ...and the range the measured growth is trusted in */
+#define BRANCHMAX 10.0
+#define EASYSHARE 0.9       /* time mode: a best move which keeps this share of the root nodes... */
+#define EASYTIME 0.2        /* ...is played after EASYTIME*maxtime */
 
 #define SINGLEEXTEND 5 /* 5 looks good here */
 
@@ -58,4 +89,15 @@
 													  are stored in deep */
 #define HASHITER 2
 
-#undef ANALYSISMODULE /* compiles a version of cake++ which analyses all moves */
+#define SMP                 /* compile in lazy smp: helper threads share the hashtables */
+#define MAXTHREADS 64       /* upper limit for cake_setthreads() */
+#define SMPSTACKSIZE 0x00400000 /* 4MB stack for each helper thread */
+#define SPLITDEPTH 40       /* ybwc: only split nodes with at least this depth */
+#define SPLITMAX 256        /* ybwc: number of split points which can be active */
+
+#define PONDER              /* cake_ponder(): search on the opponent's time */
+#define MAXMULTIPV 8        /* upper limit for cake_setmultipv() */
+#define HISTORYMAX 0x00100000 /* the history table is halved when its total gets larger */
+#define LOGSIZE 1024        /* records in the log ring, a power of 2. see cake_readlog() */
+#define LOGWRITER           /* a thread which writes the log ring to a file, see cake_logtofile() */
+#define LOGWAIT 50          /* ...and looks for new records every LOGWAIT ms */
@@ -7,6 +7,18 @@
 #include "structs.h"
 #include "cakepp.h"
 
+/* the bench searches the 64 test positions to BENCHDEPTH. its signature is the
+	total number of nodes: any change which changes the search changes it, so
+   update BENCHSIGNATURE with such changes and only with them */
+#define BENCHDEPTH 13
+#define BENCHSIGNATURE 8997901
+
+/* the multi-pv test: the second line of a multi-pv search has to agree with
+	single-pv searches of the position after its move, one ply shallower and
+   one ply deeper, within MULTIPVTOLERANCE */
+#define MULTIPVDEPTH 11
+#define MULTIPVTOLERANCE 30
+
 #define BLACK 2
 #define WHITE 1
 #define MAN   4
@@ -209,7 +221,6 @@ testcake_main()
    char str[2550];
    struct pos p;
    int color=BLACK;
-   extern int cake_nodes;
    int newnodes[80];
    int allnodes=0,refallnodes=0;
    double allratio=1;
@@ -285,9 +296,9 @@ testcake_main()
       printboard(p);
       cake_getmove(&p,color,1,1,19,10000,str,&play,2,1);
       color=color^CC;
-      printf("\nnew:%i old%i nodes",cake_nodes,m[i]);
+      printf("\nnew:%u old%i nodes",cake_nodes,m[i]);
       printf("  %f",(float)cake_nodes/(float)m[i]*100);
-      fprintf(fp2,"\n%2i \t%10i \t%10i \t%3.1f \t%3.1f",i,cake_nodes,m[i],(float)cake_nodes/(float)m[i]*100,(float)cake_nodes/(float)org_n[i]*100);
+      fprintf(fp2,"\n%2i \t%10u \t%10i \t%3.1f \t%3.1f",i,cake_nodes,m[i],(float)cake_nodes/(float)m[i]*100,(float)cake_nodes/(float)org_n[i]*100);
       fflush(fp2);
       newnodes[i]=cake_nodes;
       allnodes+=cake_nodes;
@@ -314,6 +325,130 @@ testcake_main()
    return 1;
 }
 
+int testcake_bench(int depth, int32 signature)
+{
+   /* search the test positions to depth without book and endgame database, so that
+   	the result only depends on the search. prints the total number of nodes, the
+      speed and the geometric mean of the node ratios to the reference m[].
+      depth 0 is BENCHDEPTH, signature 0 the BENCHSIGNATURE of BENCHDEPTH.
+      returns 0 if the total is the signature, 1 if it is not */
+   int i;
+   int play=0;
+   char str[256];
+   struct pos p;
+   int color=BLACK;
+   extern int maxNdb;
+   int dbpieces;
+   int32 allnodes=0;
+   double logratio=0;
+   double start,elapsed;
+
+   if(depth<=0) depth=BENCHDEPTH;
+   if(signature==0 && depth==BENCHDEPTH) signature=BENCHSIGNATURE;
+   if(!initcake(0))
+   	{
+      printf("bench: not enough memory\n");
+      return 1;
+      }
+   printf("\n");
+   cake_setbook(NULL,0);
+   dbpieces=maxNdb;
+   maxNdb=0;
+   start=walltime();
+   for(i=0;i<64;i++)
+   	{
+      p.bm=testpos[i][0];
+      p.bk=testpos[i][1];
+      p.wm=testpos[i][2];
+      p.wk=testpos[i][3];
+      cake_getmove(&p,color,1,1,depth,10000,str,&play,0,1);
+      color=color^CC;
+      printf("%2i %10u\n",i,cake_nodes);
+      allnodes+=cake_nodes;
+      if(cake_nodes>0)
+      	logratio+=log((double)cake_nodes/(double)m[i]);
+      }
+   elapsed=walltime()-start;
+   maxNdb=dbpieces;
+   exitcake();
+
+   printf("depth %i\n",depth);
+   printf("nodes %u\n",allnodes);
+   printf("time %.2fs\n",elapsed);
+   printf("nps %.0f\n",elapsed>0 ? allnodes/elapsed : 0);
+   printf("geometric mean of the ratios to the reference: %f\n",exp(logratio/64));
+   if(signature==0)
+   	{
+      printf("no signature for depth %i\n",depth);
+      return 0;
+      }
+   if(allnodes!=signature)
+   	{
+      printf("signature mismatch: %u, expected %u\n",allnodes,signature);
+      return 1;
+      }
+   printf("signature ok\n");
+   return 0;
+}
+
+int testcake_multipv(int depth)
+{
+   /* search the test positions with two lines and check the value of the second
+   	against single-pv searches of the position after its move to depth-2 and depth.
+      the depths of cake++ are odd, so these two enclose the depth of the line.
+      positions where the reply is forced are skipped: cake++ doesn't think about
+      forced moves. returns the number of positions where the value is off */
+   struct cakeengine *multi,*single;
+   struct cakeline lines[2];
+   struct cakestats stats;
+   struct pos p;
+   char str[256];
+   int i,n,color=BLACK,play=0;
+   int v1,v2,low,high,off=0,tested=0;
+
+   if(depth<=0) depth=MULTIPVDEPTH;
+   multi=cake_createengine(0);
+   single=cake_createengine(0);
+   if(multi==NULL || single==NULL)
+   	{
+      printf("multipv: not enough memory\n");
+      cake_destroyengine(multi);
+      cake_destroyengine(single);
+      return 1;
+      }
+   cake_setmultipv(multi,2);
+   cake_setbook(multi,0);
+   cake_setbook(single,0);
+   for(i=0;i<64;i++,color=color^CC)
+   	{
+      p.bm=testpos[i][0];
+      p.bk=testpos[i][1];
+      p.wm=testpos[i][2];
+      p.wk=testpos[i][3];
+      cake_enginegetmove(multi,&p,color,1,0,depth,0,str,&play,0,1);
+      n=cake_getlines(multi,lines,2);
+      if(n<2) continue;
+      p=lines[1].position;
+      v1=-cake_enginegetmove(single,&p,color^CC,1,0,depth-2,0,str,&play,0,1);
+      cake_getstats(single,&stats);
+      if(stats.depth<depth-2) continue;
+      p=lines[1].position;
+      v2=-cake_enginegetmove(single,&p,color^CC,1,0,depth,0,str,&play,0,1);
+      low=v1<v2 ? v1 : v2;
+      high=v1<v2 ? v2 : v1;
+      tested++;
+      if(lines[1].value<low-MULTIPVTOLERANCE || lines[1].value>high+MULTIPVTOLERANCE)
+      	{
+         printf("%2i line 2 %i, single-pv %i and %i: %s\n",i,lines[1].value,v1,v2,lines[1].pv);
+         off++;
+         }
+      }
+   cake_destroyengine(multi);
+   cake_destroyengine(single);
+   printf("multipv: %i of %i second lines off\n",off,tested);
+   return off;
+}
+
 
 int InitBoard(int b[8][8])
 {
@@ -0,0 +1,174 @@
+/* tree.c: analyzes the search trees which cake++ records
+
+	compile cake++ with TREELOG defined and call cake_settreefile() before the
+   searches. every node the main thread leaves is a record in the file, after
+   all of its children, and the root of every iteration closes its tree. an
+   aspiration re-search is an iteration of its own. this program rebuilds the
+   trees from that order and prints
+
+      - the iterations with their nodes
+      - for every ply the nodes, the branching factor and why the nodes returned
+      - at which move of the movelist the beta cutoffs came
+      - the largest subtrees on the first plies
+
+   usage: tree [file [n [plies]]]    (default tree.bin, the 10 largest subtrees
+   	on each of the first 2 plies) */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "structs.h"
+
+#define MAXPLY 128
+#define MAXINDEX 8        /* cutoffs at this move or later are counted together */
+#define MAXTOP 100
+#define MAXTOPPLY 8
+#define NCUTOFF 9
+
+static char *cutoffname[NCUTOFF]={"moves","beta","hash","etc","db","probcut","rep","mate","leaf"};
+
+struct subtree
+	{
+   struct treerecord r;
+   int iteration;
+   unsigned int nodes;
+   };
+
+struct plystats
+	{
+   unsigned int nodes;
+   unsigned int expanded;        /* nodes with children */
+   unsigned int children;        /* ...and how many */
+   unsigned int cutoff[NCUTOFF];
+   unsigned int beta[MAXINDEX+1]; /* beta cutoffs by the index of the move */
+   };
+
+static void addtop(struct subtree top[], int *ntop, int n, struct subtree *s)
+	{
+   /* keep the n largest subtrees in top, largest first */
+   int i;
+
+   if(*ntop==n && top[n-1].nodes>=s->nodes) return;
+   if(*ntop<n) (*ntop)++;
+   for(i=*ntop-1;i>0 && top[i-1].nodes<s->nodes;i--)
+   	top[i]=top[i-1];
+   top[i]=*s;
+   }
+
+static double percent(unsigned int a, unsigned int b)
+	{
+   return b ? 100.0*a/b : 0.0;
+   }
+
+int main(int argc, char *argv[])
+	{
+   static struct plystats ply[MAXPLY+1];
+   static struct subtree top[MAXTOPPLY+1][MAXTOP];
+   int ntop[MAXTOPPLY+1]={0};
+   /* nodes and children of the node which is open on every ply, so far */
+   static unsigned int below[MAXPLY+2],kids[MAXPLY+2];
+   struct treeheader header;
+   struct treerecord records[1024];
+   struct subtree s;
+   char *filename="tree.bin";
+   FILE *fp;
+   int n=10,plies=2,iteration=0,maxply=0;
+   int i,j,k,m,p;
+   unsigned int total=0,beta[MAXINDEX+1]={0},betas=0,iterstart=0;
+
+   if(argc>1) filename=argv[1];
+   if(argc>2) n=atoi(argv[2]);
+   if(argc>3) plies=atoi(argv[3]);
+   if(n<1) n=1;
+   if(n>MAXTOP) n=MAXTOP;
+   if(plies<0) plies=0;
+   if(plies>MAXTOPPLY) plies=MAXTOPPLY;
+   fp=fopen(filename,"rb");
+   if(fp==NULL)
+   	{
+      printf("can't open %s\n",filename);
+      return 1;
+      }
+   if(fread(&header,sizeof(header),1,fp)!=1 || header.magic!=TREEMAGIC || header.recordsize!=sizeof(struct treerecord))
+   	{
+      printf("%s is not a tree file of this cake++\n",filename);
+      return 1;
+      }
+   printf("%u records%s\n\n",header.n,header.n>=header.size ? ", the file is full" : "");
+
+   printf("iteration  depth      nodes  value\n");
+   while(total<header.n && (m=fread(records,sizeof(struct treerecord),1024,fp))>0)
+   	{
+      for(i=0;i<m && total<header.n;i++,total++)
+      	{
+         p=records[i].ply;
+         if(p>MAXPLY) p=MAXPLY;
+         if(p>maxply) maxply=p;
+         /* everything which was recorded on the next ply since the last node
+         	of this ply is below this node */
+         s.r=records[i];
+         s.iteration=iteration+1;
+         s.nodes=1+below[p+1];
+         ply[p].nodes++;
+         if(kids[p+1])
+         	{
+            ply[p].expanded++;
+            ply[p].children+=kids[p+1];
+            }
+         below[p+1]=0;
+         kids[p+1]=0;
+         below[p]+=s.nodes;
+         kids[p]++;
+         if(s.r.cutoff<NCUTOFF) ply[p].cutoff[s.r.cutoff]++;
+         if(s.r.cutoff==TREEBETA && s.r.move!=TREENOMOVE)
+         	{
+            k=s.r.move<MAXINDEX ? s.r.move : MAXINDEX;
+            ply[p].beta[k]++;
+            beta[k]++;
+            betas++;
+            }
+         if(p==0)
+         	{
+            /* a root: its iteration is done */
+            iteration++;
+            printf("%9i %6i %10u %6i\n",iteration,s.r.depth/10,total+1-iterstart,s.r.value);
+            iterstart=total+1;
+            below[0]=0;
+            kids[0]=0;
+            }
+         else if(p<=plies)
+         	addtop(top[p],&ntop[p],n,&s);
+         }
+      }
+   fclose(fp);
+
+   printf("\n  ply      nodes   expanded   bf  moves   beta   hash    etc     db probcut  rep   mate   leaf  first\n");
+   for(p=0;p<=maxply;p++)
+   	{
+      printf("%5i %10u %10u %5.2f",p,ply[p].nodes,ply[p].expanded,
+      	ply[p].expanded ? (double)ply[p].children/ply[p].expanded : 0.0);
+      for(j=0;j<NCUTOFF;j++)
+      	printf(" %5.1f%%",percent(ply[p].cutoff[j],ply[p].nodes));
+      printf(" %5.1f%%\n",percent(ply[p].beta[0],ply[p].cutoff[TREEBETA]));
+      }
+   printf("bf: children of the expanded nodes. the cutoff columns are the share of the nodes\n");
+   printf("which returned for that reason, first the share of beta cutoffs by the first move\n");
+
+   printf("\nbeta cutoffs by the index of the move (%u):\n",betas);
+   for(k=0;k<=MAXINDEX;k++)
+   	printf("%s%i%s %5.1f%%\n",k==MAXINDEX ? ">=" : "  ",k,k==MAXINDEX ? "" : "  ",percent(beta[k],betas));
+
+   for(p=1;p<=plies;p++)
+   	{
+      printf("\nlargest subtrees on ply %i:\n",p);
+      printf("iteration  key      lock      depth window        value cutoff  move      nodes  share\n");
+      for(i=0;i<ntop[p];i++)
+      	{
+         s=top[p][i];
+         printf("%9i  %08x %08x %5i [%5i,%5i] %6i %-7s %4i %10u %5.1f%%\n",s.iteration,s.r.key,s.r.lock,
+         	s.r.depth,s.r.alpha,s.r.beta,s.r.value,s.r.cutoff<NCUTOFF ? cutoffname[s.r.cutoff] : "?",
+            s.r.move==TREENOMOVE ? -1 : s.r.move,s.nodes,percent(s.nodes,header.n));
+         }
+      }
+   return 0;
+   }
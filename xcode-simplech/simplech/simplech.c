@@ -1829,3 +1829,111 @@ int  testcapture(int b[46], int color)
     }
     return(0);
 }
+
+
+/*-------------- PART IV: BENCH ----------------------------------------------*/
+
+#ifdef STATISTICS
+/*----------> the test positions of cake++ (testpos in testcake.c) as bitboards
+ bm bk wm wk, bit 0 is square 4 and bit 31 is square 29 */
+static const unsigned int benchpos[64][4]={
+    {0xFFF,0,0xFFF00000,0},{0x2DFF,0,0xFFF00000,0},{0x2DFF,0,0xFF780000,0},{0x65FF,0,0xFF780000,0},
+    {0x65FF,0,0xF7F80000,0},{0x67EF,0,0xF7F80000,0},{0x67EF,0,0xF7F08000,0},{0x75EF,0,0xF7F08000,0},
+    {0x75EF,0,0xF7E18000,0},{0x255CF,0,0xF7E08000,0},{0x255CF,0,0xF5F08000,0},{0x251DE,0,0xF5E08000,0},
+    {0x251DE,0,0xD7E08000,0},{0x253CE,0,0xD7E08000,0},{0x253CE,0,0x5FE08000,0},{0x25B4E,0,0x5FE08000,0},
+    {0x25B4E,0,0x5FA88000,0},{0x25F0A,0,0x5FA80000,0},{0x25F0A,0,0x5FA08000,0},{0x27702,0,0x5FA00000,0},
+    {0x27702,0,0x5DB00000,0},{0x27720,0,0x5DB00000,0},{0x27720,0,0x4FB00000,0},{0x36620,0,0x4F900000,0},
+    {0x36620,0,0x47D00000,0},{0x37420,0,0x47D00000,0},{0x37420,0,0x47980000,0},{0x73420,0,0x47980000,0},
+    {0x73420,0,0x47908000,0},{0x77020,0,0x47908000,0},{0x77020,0,0x47900800,0},{0x77200,0,0x47900800,0},
+    {0x77200,0,0x47900040,0},{0x73200,0,0x47104040,0},{0x33200,0,0x45144040,0},{0x2023200,0,0x45044040,0},
+    {0x2023200,0,0x41444040,0},{0x2203200,0,0x41444040,0},{0x2203200,0,0x41440840,0},{0x203200,0x20000000,0x41440840,0},
+    {0x203200,0x20000000,0x41404840,0},{0x203200,0x4000000,0x41404840,0},{0x203200,0x4000000,0x41084840,0},{0x221200,0x4000000,0x41084840,0},
+    {0x221200,0x4000000,0x41080C40,0},{0x221200,0x400000,0x41080C40,0},{0x221200,0x400000,0x41004C40,0},{0x221200,0x80000,0x41004C40,0},
+    {0x221200,0x80000,0x41004C00,0x4},{0x230200,0x80000,0x41004C00,0x4},{0x230200,0x80000,0x41004440,0x4},{0x232000,0x80000,0x41004440,0x4},
+    {0x232000,0x80000,0x41004440,0x20},{0x310000,0x80000,0x40004440,0x20},{0x310000,0x80000,0x40004440,0x200},{0x2210000,0x80000,0x40004440,0x200},
+    {0x2210000,0x80000,0x40004400,0x204},{0x210000,0x20080000,0x40004400,0x204},{0x210000,0x20080000,0x40004400,0x1004},{0x300000,0x20080000,0x40004400,0x1004},
+    {0x300000,0x20080000,0x40004400,0x1040},{0x1200000,0x20080000,0x40004400,0x1040},{0x1200000,0x20080000,0x40004400,0x1800},{0x3000000,0x20080000,0x40004400,0x1800}
+};
+
+/*----------> the signature is the number of nodes of the bench at BENCHDEPTH.
+ ----------> any change of the search changes it: update it with such changes,
+ ----------> and only with them */
+#define BENCHDEPTH 8
+#define BENCHSIGNATURE 5644012
+
+MONExternC int EXPORT_API bench(int depth, unsigned int signature, char str[256])
+/*----------> purpose: search the bench positions to a fixed depth, write the number
+ ---------->          of nodes and the speed in str. depth 0 is BENCHDEPTH, signature
+ ---------->          0 is BENCHSIGNATURE at BENCHDEPTH.
+ ----------> returns 0 if the number of nodes is the signature, 1 if it is not */
+{
+    int i,j,d,square;
+    int color=BLACK;
+    int eval;
+    int playnowvalue=0;
+    int board[46];
+    unsigned int nodes=0;
+    double start,elapsed;
+    struct move2 best;
+    
+    if(depth<=0) depth=BENCHDEPTH;
+    if(signature==0 && depth==BENCHDEPTH) signature=BENCHSIGNATURE;
+    play=&playnowvalue;
+    start=clock();
+    for(i=0;i<64;i++)
+    {
+        /* initialize board */
+        for(j=0;j<46;j++)
+            board[j]=OCCUPIED;
+        for(j=5;j<=40;j++)
+            board[j]=FREE;
+        for(j=9;j<=36;j+=9)
+            board[j]=OCCUPIED;
+        for(j=0;j<32;j++)
+        {
+            square=5+j+(j/4+1)/2;
+            if(benchpos[i][0] & (1u<<j)) board[square]=BLACK|MAN;
+            if(benchpos[i][1] & (1u<<j)) board[square]=BLACK|KING;
+            if(benchpos[i][2] & (1u<<j)) board[square]=WHITE|MAN;
+            if(benchpos[i][3] & (1u<<j)) board[square]=WHITE|KING;
+        }
+        /*----------> iterative deepening like checkers(), but to a fixed depth */
+        alphabetas=0;
+        for(d=1;d<=depth;d++)
+        {
+            eval=firstalphabeta(board,d,-10000,10000,color,&best);
+            if(eval==5000 || eval==-5000) break;
+        }
+        nodes+=alphabetas;
+        color=color^CHANGECOLOR;
+    }
+    elapsed=(clock()-start)/CLOCKS_PER_SEC;
+    
+    sprintf(str,"depth %i nodes %u time %.2fs nps %.0f",depth,nodes,elapsed,elapsed>0 ? nodes/elapsed : 0);
+    if(signature!=0 && nodes!=signature)
+    {
+        sprintf(str+strlen(str),"\nsignature mismatch: expected %u",signature);
+        return 1;
+    }
+    return 0;
+}
+
+#ifdef BENCHMAIN
+/*----------> a command line bench on its own:
+ cc -O2 -DBENCHMAIN simplech.c -o simplech-bench
+ simplech-bench [depth [signature]] exits with 1 if the signature does not match */
+int main(int argc, char *argv[])
+{
+    int depth=0;
+    unsigned int signature=0;
+    int result;
+    char str[256];
+    
+    if(argc>1) depth=atoi(argv[1]);
+    if(argc>2) signature=(unsigned int)strtoul(argv[2],NULL,10);
+    result=bench(depth,signature,str);
+    printf("%s\n",str);
+    return result;
+}
+#endif
+#endif